@@ -0,0 +1,133 @@
+#include "AllocCounter.h"
+
+#ifdef ALLOC_COUNTER
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#define ALLOC_THREAD_LOCAL __declspec(thread)
+#else
+#define ALLOC_THREAD_LOCAL __thread
+#endif
+
+// VS2012 has no noexcept
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define ALLOC_NOEXCEPT throw()
+#else
+#define ALLOC_NOEXCEPT noexcept
+#endif
+
+static std::atomic<uint64_t> s_numAllocations(0);
+static ALLOC_THREAD_LOCAL uint64_t s_numThreadAllocations = 0;
+
+namespace AllocCounter
+{
+
+bool isEnabled()
+{
+	return true;
+}
+
+uint64_t getNumAllocations()
+{
+	return s_numAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t getNumThreadAllocations()
+{
+	return s_numThreadAllocations;
+}
+
+}
+
+static void* countedAlloc(size_t size)
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	++s_numThreadAllocations;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) ALLOC_NOEXCEPT
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	++s_numThreadAllocations;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) ALLOC_NOEXCEPT
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	++s_numThreadAllocations;
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+// the sized versions are called instead when the compiler knows the size, C++14 onwards
+void operator delete(void* ptr, size_t) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) ALLOC_NOEXCEPT
+{
+	free(ptr);
+}
+
+#else
+
+namespace AllocCounter
+{
+
+bool isEnabled()
+{
+	return false;
+}
+
+uint64_t getNumAllocations()
+{
+	return 0;
+}
+
+uint64_t getNumThreadAllocations()
+{
+	return 0;
+}
+
+}
+
+#endif//ALLOC_COUNTER
@@ -0,0 +1,43 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+#include <assert.h>
+
+// Counts every call to the global operator new, which AllocCounter.cpp replaces.
+// Reading the counter before and after some code tells how many heap allocations it made.
+// Only the builds that define ALLOC_COUNTER replace new and delete: the Debug configuration, or a release
+// build made to read the allocations of -bench. Elsewhere nothing is counted and the counters stay at 0
+namespace AllocCounter
+{
+	bool isEnabled();
+	uint64_t getNumAllocations();
+	// only the ones made by the calling thread, so it can be checked while other threads allocate
+	uint64_t getNumThreadAllocations();
+
+	// asserts that the calling thread doesn't allocate until the end of the scope
+	class NoAllocScope
+	{
+	private:
+		const char* m_name;
+		uint64_t m_startAllocs;
+
+		NoAllocScope(const NoAllocScope&);
+		NoAllocScope& operator=(const NoAllocScope&);
+	public:
+		explicit NoAllocScope(const char* name) : m_name(name), m_startAllocs(getNumThreadAllocations()) {}
+		~NoAllocScope()	{ assert(getNumThreadAllocations() == m_startAllocs && "Heap allocation in a no allocation scope"); }
+	};
+};
+
+// Debug builds with the counter only, e.g. ASSERT_NO_ALLOC_SCOPE("board update"). The name shows up in the
+// debugger when it fires
+#if defined(NDEBUG) || !defined(ALLOC_COUNTER)
+#define ASSERT_NO_ALLOC_SCOPE(name)
+#else
+#define ASSERT_NO_ALLOC_SCOPE_NAME2(line) noAllocScope##line
+#define ASSERT_NO_ALLOC_SCOPE_NAME(line) ASSERT_NO_ALLOC_SCOPE_NAME2(line)
+#define ASSERT_NO_ALLOC_SCOPE(name) AllocCounter::NoAllocScope ASSERT_NO_ALLOC_SCOPE_NAME(__LINE__)(name)
+#endif
+
+#endif//ALLOC_COUNTER_H
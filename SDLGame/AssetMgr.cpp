@@ -7,36 +7,103 @@
 #include <SDL_mixer.h>
 
 #include <iostream>
+#include <algorithm>
 
 #include <assert.h>
 
 using namespace std;
-const AssetMgr::FontInfo AssetMgr::s_fontInfo[] = {	{"../data/fonts/FreeSans.ttf", 40}, 
-													{"../data/fonts/FreeSans.ttf", 30} };
+const char* const AssetMgr::kDataDir = "../data/";
+const char* const AssetMgr::kPackFile = "../data.pak";
+
+static const char* const kBackgroundFile = "BackGround.jpg";
+static const char* const kMusicFile = "sounds/music.wav";
+static const char* const kMovedSoundFile = "sounds/swap.wav";
+static const char* const kWrongSoundFile = "sounds/wrong.wav";
+static const char* const kErasedSoundFile = "sounds/erase.wav";
+//the music plays on its own channel, the sound effects use whichever other one is free
+static const int kMusicChannel = 0;
+
+const AssetMgr::FontInfo AssetMgr::s_fontInfo[] = {	{"fonts/FreeSans.ttf", 40}, 
+													{"fonts/FreeSans.ttf", 30},
+													{"fonts/FreeSans.ttf", 14} };
+const char* const AssetMgr::s_gemFiles[] = {	
+	"Red.png",
+	"Blue.png",
+	"Green.png",
+	"Yellow.png",
+	"Purple.png"
+};
+
 AssetMgr::AssetMgr(SDL_Renderer* renderer) :
+	m_nextTask(0),
+	m_pRenderer(renderer),
+	m_bLoaded(false),
+	m_numTasksFinished(0),
+	m_bgSurface(nullptr),
+	m_initTime_ms(0.0),
+	m_firstUpdateTime_ms(-1.0),
+	m_loadedTime_ms(0.0),
+	m_uploadTime_ms(0.0),
+	m_startTime(chrono::high_resolution_clock::now()),
+	m_gemAtlasTex(nullptr),
 	m_bgTex(nullptr),
 	m_music(nullptr),
 	m_moved(nullptr),
 	m_wrong(nullptr),
 	m_erased(nullptr)
 {
-	initImage(renderer);
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		m_gemSurfaces[i] = nullptr;
+	}
+	m_fonts.resize(static_cast<int>(EFontType::EFT_COUNT), nullptr);
+
+	initImage();
 	initAudio();
 	initFonts();
+	m_initTime_ms = getElapsed_ms();
+
+	//the pack has everything ready to use, the loose files are decoded on worker threads
+	if (openPack())
+	{
+		loadFromPack();
+		m_bLoaded = true;
+		m_loadedTime_ms = getElapsed_ms();
+	}
+	else
+	{
+		addLoadTasks();
+		startWorkers();
+	}
 }
 
 
 AssetMgr::~AssetMgr(void)
 {
+	//the workers may still be decoding if the game is closed while loading
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	SDL_FreeSurface(m_bgSurface);
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		SDL_FreeSurface(m_gemSurfaces[i]);
+	}
+
 	{//Release Fonts
 		for (auto& font : m_fonts)
 		{
-			TTF_CloseFont(font);
+			if (font)
+			{
+				TTF_CloseFont(font);
+			}
 		}
 		TTF_Quit();
 	}
 	{//Release Audio
-		Mix_FreeMusic(m_music);
+		Mix_FreeChunk(m_music);
 		m_music = nullptr;
 
 		Mix_FreeChunk(m_moved);
@@ -53,46 +120,152 @@ AssetMgr::~AssetMgr(void)
 	}
 	{//Release Image
 		SDL_DestroyTexture(m_bgTex);
-		for (auto& gemTex : m_gemTextures)
-		{
-			SDL_DestroyTexture(gemTex);
-		}
+		SDL_DestroyTexture(m_gemAtlasTex);
 
 		IMG_Quit();
 	}
 }
 
+double AssetMgr::getElapsed_ms() const
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - m_startTime).count();
+}
+
 void AssetMgr::initAudio()
 {
-	if (Mix_OpenAudio(/*frequency =*/44100, MIX_DEFAULT_FORMAT, /*channels =*/2, /*bytes =*/2048) < 0)
+	if (!openAudioDevice())
 	{
 		cout << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << endl;
 		exit(1);
 	}
-	loadSounds();
+	Mix_ReserveChannels(1);
 }
 
-void AssetMgr::initFonts()
+bool AssetMgr::openAudioDevice()
 {
-	if (TTF_Init() != 0)
+	return Mix_OpenAudio(/*frequency =*/44100, MIX_DEFAULT_FORMAT, /*channels =*/2, /*bytes =*/2048) >= 0;
+}
+
+string AssetMgr::getFilePath(const char* name)
+{
+	return string(kDataDir) + name;
+}
+
+bool AssetMgr::openPack()
+{
+	if (!m_pack.open(kPackFile))
+		return false;
+
+	//the sounds in the pack can only be played as they are by a device of the same format
+	int frequency, channels;
+	Uint16 format;
+	Mix_QuerySpec(&frequency, &format, &channels);
+	const AssetPack::Header& header = m_pack.getHeader();
+	if (header.audioFrequency != static_cast<uint32_t>(frequency) || header.audioFormat != format || header.audioChannels != channels)
+	{
+		cout << kPackFile << " was built for another audio format, loading the loose files" << endl;
+		m_pack.close();
+		return false;
+	}
+	return true;
+}
+
+const AssetPack::Entry& AssetMgr::findPackEntry(const char* name, uint32_t type) const
+{
+	const AssetPack::Entry* entry = m_pack.find(name);
+	if (!entry || entry->type != type)
+	{
+		cout << name << " is missing from " << kPackFile << ", rebuild it with -pack" << endl;
+		exit(1);
+	}
+	return *entry;
+}
+
+SDL_Surface* AssetMgr::createPackSurface(const char* name) const
+{
+	const AssetPack::Entry& entry = findPackEntry(name, AssetPackFormat::EET_IMAGE);
+	//the surface reads the pixels straight from the mapping, they are never written
+	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(const_cast<uint8_t*>(m_pack.getData(entry)), entry.w, entry.h, 32, entry.pitch,
+													0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (!surface)
+	{
+		Utils::logSDLError("CreateRGBSurfaceFrom");
+		exit(1);
+	}
+	return surface;
+}
+
+Mix_Chunk* AssetMgr::createPackChunk(const char* name) const
+{
+	const AssetPack::Entry& entry = findPackEntry(name, AssetPackFormat::EET_SOUND);
+	//SDL_mixer plays the samples in place and doesn't free them with the chunk
+	Mix_Chunk* chunk = Mix_QuickLoad_RAW(const_cast<uint8_t*>(m_pack.getData(entry)), entry.size);
+	if (!chunk)
+	{
+		cout << "Failed to load " << name << " sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
+		exit(1);
+	}
+	return chunk;
+}
+
+void AssetMgr::loadFromPack()
+{
+	auto start = chrono::high_resolution_clock::now();
+	{
+		const AssetPack::Entry& entry = findPackEntry(kBackgroundFile, AssetPackFormat::EET_IMAGE);
+		m_bgTex = SDL_CreateTexture(m_pRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, entry.w, entry.h);
+		if (!m_bgTex || SDL_UpdateTexture(m_bgTex, nullptr, m_pack.getData(entry), entry.pitch) != 0)
+		{
+			Utils::logSDLError("CreateTexture");
+			exit(1);
+		}
+	}
+
+	SDL_Surface* gemSurfaces[kNumGemTypes];
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		gemSurfaces[i] = createPackSurface(s_gemFiles[i]);
+	}
+	bool spritesLoaded = packGemAtlas(gemSurfaces, kNumGemTypes, m_pRenderer);
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		SDL_FreeSurface(gemSurfaces[i]);
+	}
+	if (!spritesLoaded)
 	{
-		Utils::logSDLError("TTF_Init");
 		exit(1);
 	}
+	m_uploadTime_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	m_music = createPackChunk(kMusicFile);
+	m_moved = createPackChunk(kMovedSoundFile);
+	m_wrong = createPackChunk(kWrongSoundFile);
+	m_erased = createPackChunk(kErasedSoundFile);
 
 	for(int i = 0; i < static_cast<int>(EFontType::EFT_COUNT); ++i)
 	{
-		TTF_Font* font = TTF_OpenFont(s_fontInfo[i].file, s_fontInfo[i].size);
+		const AssetPack::Entry& entry = findPackEntry(s_fontInfo[i].file, AssetPackFormat::EET_RAW);
+		SDL_RWops* rw = SDL_RWFromConstMem(m_pack.getData(entry), entry.size);
+		TTF_Font* font = rw ? TTF_OpenFontRW(rw, /*freesrc =*/1, s_fontInfo[i].size) : nullptr;
 		if (font == nullptr)
 		{
-			Utils::logSDLError("TTF_OpenFont");
+			Utils::logSDLError("TTF_OpenFontRW");
 			exit(1);
 		}
-		m_fonts.push_back(font);
+		m_fonts[i] = font;
 	}
+}
 
+void AssetMgr::initFonts()
+{
+	if (TTF_Init() != 0)
+	{
+		Utils::logSDLError("TTF_Init");
+		exit(1);
+	}
 }
-void AssetMgr::initImage(SDL_Renderer* renderer)
+
+void AssetMgr::initImage()
 {
 	int flags = IMG_INIT_JPG | IMG_INIT_PNG;
 	if ((IMG_Init(flags) & flags) != flags)
@@ -100,91 +273,247 @@ void AssetMgr::initImage(SDL_Renderer* renderer)
 		Utils::logSDLError("IMG_Init");
 		exit(1);
 	}
-
-	loadSprites(renderer);
 }
 
-void AssetMgr::loadSprites(SDL_Renderer* renderer)
+void AssetMgr::addLoadTasks()
 {
-	m_bgTex = loadTexture("../data/BackGround.jpg", renderer);
+	//biggest first, so the longest decodes start right away
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(kBackgroundFile, [this]() 
+	{
+		m_bgSurface = loadSurface(kBackgroundFile);
+		return m_bgSurface != nullptr;
+	})));
+
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(kMusicFile, [this]() 
+	{
+		return loadChunk(kMusicFile, m_music);
+	})));
 
-	const char* gemTexFilenames[] =	{	
-		"../data/Red.png",
-		"../data/Blue.png",
-		"../data/Green.png",
-		"../data/Yellow.png",
-		"../data/Purple.png"
-	};
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(s_gemFiles[i], [this, i]() 
+		{
+			m_gemSurfaces[i] = loadSurface(s_gemFiles[i]);
+			return m_gemSurfaces[i] != nullptr;
+		})));
+	}
 
-	bool spritesLoaded = (m_bgTex != nullptr);
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(kMovedSoundFile, [this]() 
+	{
+		return loadChunk(kMovedSoundFile, m_moved);
+	})));
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(kWrongSoundFile, [this]() 
+	{
+		return loadChunk(kWrongSoundFile, m_wrong);
+	})));
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask(kErasedSoundFile, [this]() 
+	{
+		return loadChunk(kErasedSoundFile, m_erased);
+	})));
 
-	int numGems = sizeof(gemTexFilenames) / sizeof(gemTexFilenames[0]);
-	m_gemTextures.resize(numGems);
+	//FreeType can't open faces of the same library from several threads at once, so all the fonts are one task
+	m_loadTasks.push_back(unique_ptr<LoadTask>(new LoadTask("fonts", [this]() 
+	{
+		return loadFonts();
+	})));
+}
 
-	for (size_t i = 0, n = m_gemTextures.size(); i < n; ++i)
+void AssetMgr::startWorkers()
+{
+	int numWorkers = static_cast<int>(thread::hardware_concurrency());
+	numWorkers = max(1, min(numWorkers, static_cast<int>(m_loadTasks.size())));
+	for (int i = 0; i < numWorkers; ++i)
 	{
-		m_gemTextures[i] = loadTexture(gemTexFilenames[i], renderer);
-		spritesLoaded &= (m_gemTextures[i] != nullptr);
+		m_workers.push_back(thread(&AssetMgr::workerMain, this, i));
 	}
+}
 
-	assert(m_gemTextures.size() > 0);
-	assert(spritesLoaded);
+void AssetMgr::workerMain(int workerIdx)
+{
+	while (true)
+	{
+		int taskIdx = m_nextTask.fetch_add(1);
+		if (taskIdx >= static_cast<int>(m_loadTasks.size()))
+			break;
+
+		LoadTask& task = *m_loadTasks[taskIdx];
+		auto start = chrono::high_resolution_clock::now();
+		task.success = task.load();
+		task.duration_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		task.workerIdx = workerIdx;
+		//publishes the results of the task to the render thread
+		task.done.store(true, memory_order_release);
+	}
 }
 
-SDL_Texture* AssetMgr::loadTexture(const char* file, SDL_Renderer* ren)
+SDL_Surface* AssetMgr::loadSurface(const char* file)
 {
 	assert(file);
-	SDL_Texture *texture = IMG_LoadTexture(ren, file);
-	if (!texture)		
+	SDL_Surface* surface = IMG_Load(getFilePath(file).c_str());
+	if (!surface)
 	{
-		Utils::logSDLError("LoadTexture");
+		Utils::logSDLError("IMG_Load");
 	}
-	return texture;
+	return surface;
 }
 
-void AssetMgr::loadSounds()
+bool AssetMgr::loadChunk(const char* file, Mix_Chunk*& chunk)
 {
-	bool success = true;
+	chunk = Mix_LoadWAV(getFilePath(file).c_str());
+	if (!chunk)
+	{
+		cout << "Failed to load " << file << " sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
+	}
+	return chunk != nullptr;
+}
 
-	//Load music
-	m_music = Mix_LoadMUS( "../data/sounds/music.wav" );
-	if (!m_music)
+bool AssetMgr::loadFonts()
+{
+	for(int i = 0; i < static_cast<int>(EFontType::EFT_COUNT); ++i)
 	{
-		cout << "Failed to load music! SDL_mixer Error: " << Mix_GetError() << endl;
-		success = false;
+		TTF_Font* font = TTF_OpenFont(getFilePath(s_fontInfo[i].file).c_str(), s_fontInfo[i].size);
+		if (font == nullptr)
+		{
+			Utils::logSDLError("TTF_OpenFont");
+			return false;
+		}
+		m_fonts[i] = font;
 	}
+	return true;
+}
 
-	//Load sound effects
-	m_moved = Mix_LoadWAV( "../data/sounds/swap.wav" );
-	if (!m_moved)
+bool AssetMgr::update()
+{
+	if (m_bLoaded)
+		return true;
+
+	if (m_firstUpdateTime_ms < 0.0)
 	{
-		cout << "Failed to load <moved> sound effect! SDL_mixer Error: " << Mix_GetError();
-		success = false;
+		m_firstUpdateTime_ms = getElapsed_ms();
 	}
 
-	m_wrong = Mix_LoadWAV( "../data/sounds/wrong.wav" );
-	if (!m_wrong)
+	int numTasksFinished = 0;
+	for (auto& task : m_loadTasks)
 	{
-		cout << "Failed to load <wrong> sound effect! SDL_mixer Error: " << Mix_GetError();
-		success = false;
+		if (task->done.load(memory_order_acquire))
+		{
+			++numTasksFinished;
+			if (!task->success)
+			{
+				cout << "Error loading " << task->name << endl;
+				exit(1);
+			}
+		}
 	}
-	
-	m_erased = Mix_LoadWAV( "../data/sounds/erase.wav" );
-	if (!m_erased)
+
+	//the background can be shown as soon as it is decoded
+	if (!m_bgTex && m_loadTasks[0]->done.load(memory_order_acquire))
 	{
-		cout << "Failed to load <erased> sound effect! SDL_mixer Error: " << Mix_GetError();
-		success = false;
+		auto uploadStart = chrono::high_resolution_clock::now();
+		m_bgTex = SDL_CreateTextureFromSurface(m_pRenderer, m_bgSurface);
+		if (!m_bgTex)
+		{
+			Utils::logSDLError("CreateTexture");
+			exit(1);
+		}
+		SDL_FreeSurface(m_bgSurface);
+		m_bgSurface = nullptr;
+		m_uploadTime_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - uploadStart).count();
 	}
 
-	if (!success)
+	m_numTasksFinished = numTasksFinished;
+	if (numTasksFinished < static_cast<int>(m_loadTasks.size()))
+		return false;
+
+	//everything is decoded, the gems go to the GPU together as one atlas
+	auto uploadStart = chrono::high_resolution_clock::now();
+	bool spritesLoaded = packGemAtlas(m_gemSurfaces, kNumGemTypes, m_pRenderer);
+	for (int i = 0; i < kNumGemTypes; ++i)
+	{
+		SDL_FreeSurface(m_gemSurfaces[i]);
+		m_gemSurfaces[i] = nullptr;
+	}
+	if (!spritesLoaded)
 	{
-		cout << "Error loading sounds";
 		exit(1);
 	}
+	m_uploadTime_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - uploadStart).count();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	m_bLoaded = true;
+	m_loadedTime_ms = getElapsed_ms();
+	return true;
+}
+
+void AssetMgr::printLoadTimings() const
+{
+	cout << "assets: library init " << m_initTime_ms << " ms" << endl;
+	if (m_pack.isOpen())
+	{
+		cout << "assets: mapped " << kPackFile << endl;
+	}
+	for (auto& task : m_loadTasks)
+	{
+		cout << "assets: " << task->name << " decoded in " << task->duration_ms << " ms on worker " << task->workerIdx << endl;
+	}
+	cout << "assets: texture uploads " << m_uploadTime_ms << " ms" << endl;
+	cout << "assets: first frame at " << m_firstUpdateTime_ms << " ms, everything loaded at " << m_loadedTime_ms << " ms" << endl;
 }
+
+bool AssetMgr::packGemAtlas(SDL_Surface** gemSurfaces, int numGems, SDL_Renderer* renderer)
+{
+	static const int padding = 1;
+
+	//a single row is enough for a handful of gems
+	int atlasW = 0;
+	int atlasH = 0;
+	m_gemRects.resize(numGems);
+	for (int i = 0; i < numGems; ++i)
+	{
+		SDL_Rect& rect = m_gemRects[i];
+		rect.x = atlasW;
+		rect.y = 0;
+		rect.w = gemSurfaces[i]->w;
+		rect.h = gemSurfaces[i]->h;
+
+		atlasW += rect.w + padding;
+		atlasH = max(atlasH, rect.h);
+	}
+
+	SDL_Surface* atlas = SDL_CreateRGBSurface(0, atlasW, atlasH, 32, 
+											0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (!atlas)
+	{
+		Utils::logSDLError("CreateRGBSurface");
+		return false;
+	}
+
+	for (int i = 0; i < numGems; ++i)
+	{
+		//copy the alpha as is instead of blending it over the empty atlas
+		SDL_SetSurfaceBlendMode(gemSurfaces[i], SDL_BLENDMODE_NONE);
+		SDL_BlitSurface(gemSurfaces[i], nullptr, atlas, &m_gemRects[i]);
+	}
+
+	m_gemAtlasTex = SDL_CreateTextureFromSurface(renderer, atlas);
+	SDL_FreeSurface(atlas);
+	if (!m_gemAtlasTex)
+	{
+		Utils::logSDLError("CreateTexture");
+		return false;
+	}
+	SDL_SetTextureBlendMode(m_gemAtlasTex, SDL_BLENDMODE_BLEND);
+	return true;
+}
+
 void	AssetMgr::playMusic()
 {
-	Mix_FadeInMusic( m_music, /*loops =*/-1, /* ms =*/1000);
+	Mix_FadeInChannel( kMusicChannel, m_music, /*loops =*/-1, /* ms =*/1000);
 }
 void	AssetMgr::playMovedSound()
 {
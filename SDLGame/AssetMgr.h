@@ -1,18 +1,29 @@
 #ifndef ASSET_MGR_H
 #define ASSET_MGR_H
 
+#include "AssetPack.h"
+
+#include <SDL_rect.h>
+
 #include <vector>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <string>
 
 struct _TTF_Font;
-struct _Mix_Music;
 struct Mix_Chunk;
 struct SDL_Renderer;
 struct SDL_Texture;
+struct SDL_Surface;
 
 enum class EFontType: unsigned int
 {
 	EFT_FREE_SANS_BIG, 
 	EFT_FREE_SANS_MEDIUM, 
+	EFT_FREE_SANS_SMALL, 
 	EFT_COUNT
 };
 
@@ -25,36 +36,102 @@ private:
 		int size;
 	};
 
-	static const FontInfo s_fontInfo[EFontType::EFT_COUNT];
+	static const FontInfo s_fontInfo[static_cast<int>(EFontType::EFT_COUNT)];
+	static const int kNumGemTypes = 5;
+	static const char* const s_gemFiles[kNumGemTypes];
+
+	// One file (or group of files) decoded on a worker thread
+	struct LoadTask
+	{
+		const char* name;
+		std::function<bool()> load;		// runs on a worker, returns false on failure
+		std::atomic<bool> done;
+		bool success;
+		double duration_ms;
+		int workerIdx;
+
+		LoadTask(const char* name, const std::function<bool()>& load) : 
+			name(name), load(load), done(false), success(false), duration_ms(0.0), workerIdx(-1) {}
+	};
+	std::vector<std::unique_ptr<LoadTask> > m_loadTasks;
+	std::vector<std::thread> m_workers;
+	std::atomic<int> m_nextTask;
+
+	SDL_Renderer* m_pRenderer;
+	bool m_bLoaded;
+	int m_numTasksFinished;
+	
+	// decoded on the workers, turned into textures on the render thread
+	SDL_Surface* m_bgSurface;
+	SDL_Surface* m_gemSurfaces[kNumGemTypes];
+
+	// startup timings, in ms since the constructor
+	double m_initTime_ms;
+	double m_firstUpdateTime_ms;
+	double m_loadedTime_ms;
+	double m_uploadTime_ms;
+	std::chrono::high_resolution_clock::time_point m_startTime;
+
+	// mapped for as long as the sounds and fonts created from it are alive
+	AssetPack m_pack;
 
 	std::vector<_TTF_Font*> m_fonts;
-	std::vector<SDL_Texture*> m_gemTextures;
+	SDL_Texture* m_gemAtlasTex;
+	std::vector<SDL_Rect> m_gemRects;	//where each gem type is in the atlas
 	SDL_Texture* m_bgTex;
 	
-	_Mix_Music* m_music;
+	Mix_Chunk* m_music;
 	Mix_Chunk* m_moved;
 	Mix_Chunk* m_wrong;
 	Mix_Chunk* m_erased;
 	
 
-	void initImage(SDL_Renderer* renderer);
-	void loadSprites(SDL_Renderer* renderer);
-	
+	void initImage();
 	void initAudio();
-	void loadSounds();
-
 	void initFonts();
 
-	static SDL_Texture* loadTexture(const char* file, SDL_Renderer* ren);
+	bool openPack();
+	void loadFromPack();
+	const AssetPack::Entry& findPackEntry(const char* name, uint32_t type) const;
+	SDL_Surface* createPackSurface(const char* name) const;
+	Mix_Chunk* createPackChunk(const char* name) const;
+
+	void addLoadTasks();
+	void startWorkers();
+	void workerMain(int workerIdx);
+	double getElapsed_ms() const;
+
+	static std::string getFilePath(const char* name);
+	static SDL_Surface* loadSurface(const char* file);
+	static bool loadChunk(const char* file, Mix_Chunk*& chunk);
+	bool loadFonts();
+	bool packGemAtlas(SDL_Surface** gemSurfaces, int numGems, SDL_Renderer* renderer);
 public:
+	// the loose files are looked up in kDataDir, by the same names they have in the pack
+	static const char* const kDataDir;
+	static const char* const kPackFile;
+
+	// opens the audio device with the format the game plays, and the sounds of the pack are stored in
+	static bool openAudioDevice();
+
+	// initializes the libraries, then either builds every asset from kPackFile right away
+	// or starts decoding the loose files on worker threads without waiting for them
 	AssetMgr(SDL_Renderer* renderer);
 	~AssetMgr();
 
+	// render thread, once per frame while loading: uploads what the workers finished to the GPU.
+	// Returns true once every asset is ready to be used
+	bool	update();
+	bool	isLoaded() const		{ return m_bLoaded; }
+	float	getLoadProgress() const	{ return m_loadTasks.empty() ? 1.f : static_cast<float>(m_numTasksFinished) / m_loadTasks.size(); }
+	void	printLoadTimings() const;
+
 	_TTF_Font* getFont(EFontType type)			{ return m_fonts[static_cast<int>(type)]; }
 	
-	int							getNumGemTypes() const	{ return m_gemTextures.size(); }
-	std::vector<SDL_Texture*>&	getGemTextures()		{ return m_gemTextures; }
-	SDL_Texture*				getBackgroundTex()		{ return m_bgTex; }
+	int				getNumGemTypes() const			{ return kNumGemTypes; }
+	SDL_Texture*	getGemAtlasTex()				{ return m_gemAtlasTex; }
+	const SDL_Rect&	getGemRect(int gemType) const	{ return m_gemRects[gemType]; }
+	SDL_Texture*	getBackgroundTex()				{ return m_bgTex; }
 	
 	void	playMusic();
 	void	playMovedSound();
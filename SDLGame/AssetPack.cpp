@@ -0,0 +1,396 @@
+#include "AssetPack.h"
+#include "Common.h"
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#include <assert.h>
+
+using namespace std;
+using namespace AssetPackFormat;
+
+static const char kMagic[4] = { 'D', 'M', 'P', 'K' };
+
+static bool entryLess(const AssetPack::Entry& a, const AssetPack::Entry& b)
+{
+	return strcmp(a.name, b.name) < 0;
+}
+
+static uint32_t alignUp(uint32_t value)
+{
+	return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+AssetPack::AssetPack() :
+	m_pData(nullptr),
+	m_size(0),
+	m_pHeader(nullptr),
+	m_pEntries(nullptr)
+#ifdef _WIN32
+	,m_hFile(INVALID_HANDLE_VALUE),
+	m_hMapping(nullptr)
+#endif
+{
+}
+
+AssetPack::~AssetPack()
+{
+	close();
+}
+
+bool AssetPack::open(const char* file)
+{
+	close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		close();
+		return false;
+	}
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = ::open(file, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps its own reference to the file
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	m_pData = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(st.st_size);
+#endif
+
+	if (!m_pData || !validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void AssetPack::close()
+{
+#ifdef _WIN32
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_size);
+	}
+#endif
+	m_pData = nullptr;
+	m_size = 0;
+	m_pHeader = nullptr;
+	m_pEntries = nullptr;
+}
+
+bool AssetPack::validate()
+{
+	if (m_size < sizeof(Header))
+		return false;
+
+	const Header* header = reinterpret_cast<const Header*>(m_pData);
+	if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion)
+		return false;
+	if (header->numEntries > (m_size - sizeof(Header)) / sizeof(Entry))
+		return false;
+
+	const Entry* entries = reinterpret_cast<const Entry*>(m_pData + sizeof(Header));
+	for (uint32_t i = 0; i < header->numEntries; ++i)
+	{
+		const Entry& entry = entries[i];
+		if (entry.type >= EET_COUNT || entry.offset > m_size || entry.size > m_size - entry.offset)
+			return false;
+		if (memchr(entry.name, 0, sizeof(entry.name)) == nullptr)
+			return false;
+		if (entry.type == EET_IMAGE && static_cast<uint64_t>(entry.pitch) * entry.h > entry.size)
+			return false;
+	}
+
+	m_pHeader = header;
+	m_pEntries = entries;
+	return true;
+}
+
+const AssetPack::Entry* AssetPack::find(const char* name) const
+{
+	if (!m_pEntries)
+		return nullptr;
+
+	Entry key;
+	strncpy(key.name, name, sizeof(key.name) - 1);
+	key.name[sizeof(key.name) - 1] = 0;
+
+	const Entry* end = m_pEntries + m_pHeader->numEntries;
+	const Entry* it = lower_bound(m_pEntries, end, key, entryLess);
+	if (it == end || strcmp(it->name, key.name) != 0)
+		return nullptr;
+	return it;
+}
+
+bool AssetPackWriter::addDirectory(const string& dir, const string& prefix)
+{
+	vector<string> files;
+	vector<string> subDirs;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((dir + "/*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		string name = findData.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			subDirs.push_back(name);
+		else
+			files.push_back(name);
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d)
+		return false;
+	while (dirent* ent = readdir(d))
+	{
+		string name = ent->d_name;
+		if (name == "." || name == "..")
+			continue;
+		struct stat st;
+		if (stat((dir + "/" + name).c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			subDirs.push_back(name);
+		else
+			files.push_back(name);
+	}
+	closedir(d);
+#endif
+
+	for (auto& file : files)
+	{
+		if (!addFile(dir + "/" + file, prefix + file))
+			return false;
+	}
+	for (auto& subDir : subDirs)
+	{
+		if (!addDirectory(dir + "/" + subDir, prefix + subDir + "/"))
+			return false;
+	}
+	return true;
+}
+
+bool AssetPackWriter::addFile(const string& path, const string& name)
+{
+	if (name.size() >= static_cast<size_t>(kMaxNameLength))
+	{
+		cout << "pack: name too long " << name << endl;
+		return false;
+	}
+
+	string ext = name.substr(min(name.size(), name.rfind('.') + 1));
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+	AssetPack::Entry entry;
+	memset(&entry, 0, sizeof(entry));
+	strcpy(entry.name, name.c_str());
+	vector<uint8_t> blob;
+
+	bool added;
+	if (ext == "png" || ext == "jpg")
+		added = addImage(path, entry, blob);
+	else if (ext == "wav")
+		added = addSound(path, entry, blob);
+	else
+		added = addRaw(path, entry, blob);
+	if (!added)
+	{
+		cout << "pack: couldn't add " << path << endl;
+		return false;
+	}
+
+	entry.size = static_cast<uint32_t>(blob.size());
+	m_entries.push_back(entry);
+	m_blobs.push_back(move(blob));
+	return true;
+}
+
+bool AssetPackWriter::addImage(const string& path, AssetPack::Entry& entry, vector<uint8_t>& blob)
+{
+	SDL_Surface* loaded = IMG_Load(path.c_str());
+	if (!loaded)
+	{
+		Utils::logSDLError("IMG_Load");
+		return false;
+	}
+	SDL_Surface* converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(loaded);
+	if (!converted)
+	{
+		Utils::logSDLError("ConvertSurfaceFormat");
+		return false;
+	}
+
+	entry.type = EET_IMAGE;
+	entry.w = converted->w;
+	entry.h = converted->h;
+	entry.pitch = converted->w * 4;
+
+	//the rows are stored tightly packed, whatever the pitch of the surface
+	blob.resize(entry.pitch * entry.h);
+	SDL_LockSurface(converted);
+	for (int y = 0; y < entry.h; ++y)
+	{
+		memcpy(&blob[y * entry.pitch], static_cast<const uint8_t*>(converted->pixels) + y * converted->pitch, entry.pitch);
+	}
+	SDL_UnlockSurface(converted);
+	SDL_FreeSurface(converted);
+	return true;
+}
+
+bool AssetPackWriter::addSound(const string& path, AssetPack::Entry& entry, vector<uint8_t>& blob)
+{
+	//SDL_mixer converts the file to the format of the open device
+	Mix_Chunk* chunk = Mix_LoadWAV(path.c_str());
+	if (!chunk)
+	{
+		cout << "Mix_LoadWAV error: " << Mix_GetError() << endl;
+		return false;
+	}
+	entry.type = EET_SOUND;
+	blob.assign(chunk->abuf, chunk->abuf + chunk->alen);
+	Mix_FreeChunk(chunk);
+	return true;
+}
+
+bool AssetPackWriter::addRaw(const string& path, AssetPack::Entry& entry, vector<uint8_t>& blob)
+{
+	ifstream in(path.c_str(), ios::binary);
+	if (!in)
+		return false;
+	entry.type = EET_RAW;
+	blob.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return true;
+}
+
+size_t AssetPackWriter::getDataSize() const
+{
+	size_t size = 0;
+	for (auto& blob : m_blobs)
+	{
+		size += blob.size();
+	}
+	return size;
+}
+
+bool AssetPackWriter::write(const char* file) const
+{
+	AssetPack::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.numEntries = static_cast<uint32_t>(m_entries.size());
+
+	int frequency, channels;
+	Uint16 format;
+	if (Mix_QuerySpec(&frequency, &format, &channels) == 0)
+	{
+		cout << "pack: the audio device isn't open" << endl;
+		return false;
+	}
+	header.audioFrequency = static_cast<uint32_t>(frequency);
+	header.audioFormat = format;
+	header.audioChannels = static_cast<uint16_t>(channels);
+
+	//the index is sorted by name for AssetPack::find, the blobs follow it in the same order
+	vector<size_t> order(m_entries.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [this](size_t a, size_t b) { return entryLess(m_entries[a], m_entries[b]); });
+
+	vector<AssetPack::Entry> entries(order.size());
+	uint32_t offset = alignUp(static_cast<uint32_t>(sizeof(header) + entries.size() * sizeof(AssetPack::Entry)));
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		entries[i] = m_entries[order[i]];
+		entries[i].offset = offset;
+		offset = alignUp(offset + entries[i].size);
+	}
+
+	vector<uint8_t> data(offset, 0);
+	memcpy(&data[0], &header, sizeof(header));
+	if (!entries.empty())
+	{
+		memcpy(&data[sizeof(header)], &entries[0], entries.size() * sizeof(AssetPack::Entry));
+	}
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const vector<uint8_t>& blob = m_blobs[order[i]];
+		if (!blob.empty())
+		{
+			memcpy(&data[entries[i].offset], &blob[0], blob.size());
+		}
+	}
+
+	ofstream out(file, ios::binary);
+	if (!out)
+		return false;
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return out.good();
+}
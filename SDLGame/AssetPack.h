@@ -0,0 +1,103 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// A pack is every file under data/ stored ready to be used, so the game maps it and builds its assets
+// straight from the mapping: no per file opens and no decoding at startup.
+//   header:	"DMPK", version (u32), numEntries (u32), audio frequency (u32), audio format (u16), audio channels (u16)
+//   index:		numEntries entries sorted by name, see AssetPack::Entry
+//   data:		the blobs, each one starting on a kAlignment boundary
+// Everything is in the byte order of the machine that built the pack, the index is read in place.
+namespace AssetPackFormat
+{
+	enum EEntryType
+	{
+		EET_IMAGE,		// pixels in SDL_PIXELFORMAT_ARGB8888, pitch bytes per row
+		EET_SOUND,		// PCM already converted to the audio format of the header
+		EET_RAW,		// the file as is (fonts)
+		EET_COUNT
+	};
+
+	static const uint32_t kVersion = 1;
+	static const uint32_t kAlignment = 16;
+	static const int kMaxNameLength = 48;
+};
+
+class AssetPack
+{
+public:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t numEntries;
+		uint32_t audioFrequency;
+		uint16_t audioFormat;
+		uint16_t audioChannels;
+	};
+
+	struct Entry
+	{
+		char name[AssetPackFormat::kMaxNameLength];		// path relative to data/, '/' separated
+		uint32_t type;
+		uint32_t offset;		// from the start of the pack
+		uint32_t size;
+		int32_t w;				// images only
+		int32_t h;
+		int32_t pitch;
+	};
+
+private:
+	const uint8_t* m_pData;
+	size_t m_size;
+	const Header* m_pHeader;
+	const Entry* m_pEntries;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+
+	bool validate();
+
+	AssetPack(const AssetPack&);
+	AssetPack& operator=(const AssetPack&);
+public:
+	AssetPack();
+	~AssetPack();
+
+	// maps the whole file read only, the data stays valid until close()
+	bool open(const char* file);
+	void close();
+	bool isOpen() const { return m_pData != nullptr; }
+
+	const Header& getHeader() const { return *m_pHeader; }
+	// nullptr if the pack has no such file
+	const Entry* find(const char* name) const;
+	const uint8_t* getData(const Entry& entry) const { return m_pData + entry.offset; }
+};
+
+// Builds a pack from a data directory. Images are decoded with SDL_image and sounds converted by SDL_mixer,
+// so the audio device must already be open with the format the game uses.
+class AssetPackWriter
+{
+private:
+	std::vector<AssetPack::Entry> m_entries;
+	std::vector<std::vector<uint8_t> > m_blobs;
+
+	bool addFile(const std::string& path, const std::string& name);
+	bool addImage(const std::string& path, AssetPack::Entry& entry, std::vector<uint8_t>& blob);
+	bool addSound(const std::string& path, AssetPack::Entry& entry, std::vector<uint8_t>& blob);
+	bool addRaw(const std::string& path, AssetPack::Entry& entry, std::vector<uint8_t>& blob);
+public:
+	// adds every file under dir, recursively
+	bool addDirectory(const std::string& dir, const std::string& prefix = "");
+	bool write(const char* file) const;
+
+	int getNumEntries() const { return static_cast<int>(m_entries.size()); }
+	size_t getDataSize() const;
+};
+#endif//ASSET_PACK_H
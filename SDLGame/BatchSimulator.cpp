@@ -0,0 +1,268 @@
+#include "BatchSimulator.h"
+#include "MoveIndex.h"
+#include "BoardGenerator.h"
+
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace std;
+
+typedef MoveIndex<kBoardRows, kBoardCols> BatchMoveIndex;
+
+BatchSimulator::BatchSimulator(int numBoards, const BatchSimConfig& config, uint64_t seed) :
+	m_config(config),
+	m_numBoards(numBoards),
+	m_elapsed_s(0.0),
+	m_numThreadsUsed(0)
+{
+	assert(numBoards > 0);
+	assert(config.numGemTypes >= 3 && config.numGemTypes <= Bits::kMaxGemTypes);
+
+	for (int color = 0; color < Bits::kMaxGemTypes; ++color)
+	{
+		m_gemMasks[color].resize(numBoards, 0);
+	}
+	m_validRight.resize(numBoards, 0);
+	m_validDown.resize(numBoards, 0);
+	m_scores.resize(numBoards, 0);
+	m_timeLeft_s.resize(numBoards, 0.f);
+	m_random.resize(numBoards);
+	m_gamesFinished.resize(numBoards, 0);
+	m_finishedScores.resize(numBoards, 0);
+
+	for (int board = 0; board < numBoards; ++board)
+	{
+		//every board gets its own stream, so batches never contend for a generator
+		m_random[board].setSeed((seed << 32) ^ static_cast<uint64_t>(board));
+		newGame(board);
+	}
+}
+
+BatchSimulator::Mask BatchSimulator::occupiedCells(int board) const
+{
+	Mask occupied = 0;
+	for (int color = 0; color < m_config.numGemTypes; ++color)
+	{
+		occupied |= m_gemMasks[color][board];
+	}
+	return occupied;
+}
+
+void BatchSimulator::newGame(int board)
+{
+	m_scores[board] = 0;
+	m_timeLeft_s[board] = m_config.gameTime_s;
+
+	//the same generator as Board, without a run and with at least one move
+	BoardLayout layout;
+	BoardGenerator::generate(m_random[board], m_config.numGemTypes, layout);
+	for (int color = 0; color < Bits::kMaxGemTypes; ++color)
+	{
+		m_gemMasks[color][board] = layout.gemMasks[color];
+	}
+}
+
+void BatchSimulator::findMoves(int begin, int end)
+{
+	Mask gems[Bits::kMaxGemTypes];
+	for (int board = begin; board < end; ++board)
+	{
+		for (int color = 0; color < m_config.numGemTypes; ++color)
+		{
+			gems[color] = m_gemMasks[color][board];
+		}
+		BatchMoveIndex::findValidSwaps(gems, Bits::kAllCells, m_config.numGemTypes, m_validRight[board], m_validDown[board]);
+	}
+}
+
+void BatchSimulator::playMoves(int begin, int end)
+{
+	for (int board = begin; board < end; ++board)
+	{
+		Mask validRight = m_validRight[board];
+		Mask validDown = m_validDown[board];
+		int numMoves = BitUtils::countBits(validRight) + BitUtils::countBits(validDown);
+
+		if (numMoves == 0)
+		{
+			//dead board, the real game drops a new set of gems
+			m_timeLeft_s[board] -= m_config.cascadeStepTime_s;
+			int score = m_scores[board];
+			float timeLeft = m_timeLeft_s[board];
+			newGame(board);
+			m_scores[board] = score;
+			m_timeLeft_s[board] = timeLeft;
+		}
+		else
+		{
+			//pick a random valid move: skip the first moveIdx set bits
+			int moveIdx = m_random[board].nextInt(numMoves);
+			bool bRight = moveIdx < BitUtils::countBits(validRight);
+			Mask moves = bRight ? validRight : validDown;
+			if (!bRight)
+			{
+				moveIdx -= BitUtils::countBits(validRight);
+			}
+			for (int i = 0; i < moveIdx; ++i)
+			{
+				moves &= moves - 1;
+			}
+
+			int idx = BitUtils::lowestBit(moves);
+			Mask bit1 = 1ULL << idx;
+			Mask bit2 = bRight ? (bit1 << 1) : (bit1 << kBoardCols);
+			for (int color = 0; color < m_config.numGemTypes; ++color)
+			{
+				Mask& gems = m_gemMasks[color][board];
+				Mask has1 = (gems & bit1) ? bit2 : 0;
+				Mask has2 = (gems & bit2) ? bit1 : 0;
+				gems = (gems & ~(bit1 | bit2)) | has1 | has2;
+			}
+
+			int cascadeSteps = resolveCascades(board);
+			assert(cascadeSteps > 0);
+			m_timeLeft_s[board] -= m_config.swapTime_s + cascadeSteps * m_config.cascadeStepTime_s;
+		}
+
+		if (m_timeLeft_s[board] <= 0.f)
+		{
+			++m_gamesFinished[board];
+			m_finishedScores[board] += m_scores[board];
+			newGame(board);
+		}
+	}
+}
+
+int BatchSimulator::resolveCascades(int board)
+{
+	const int numGemTypes = m_config.numGemTypes;
+	int steps = 0;
+
+	while (true)
+	{
+		Mask cleared = 0;
+		for (int color = 0; color < numGemTypes; ++color)
+		{
+			Mask gems = m_gemMasks[color][board];
+			Mask horizontal = Bits::horizontalRuns(gems);
+			Mask vertical = Bits::verticalRuns(gems);
+			Mask matched = horizontal | vertical;
+			if (!matched)
+				continue;
+
+			Mask crosses = Bits::floodFill(horizontal & vertical, matched);
+			m_scores[board] += BitUtils::countBits(matched) + (m_config.crossMultiplier - 1) * BitUtils::countBits(crosses);
+			m_gemMasks[color][board] = gems & ~matched;
+			cleared |= matched;
+		}
+
+		if (!cleared)
+			break;
+		++steps;
+
+		//gravity: move every gem with an empty cell below it down by one row until nothing moves
+		Mask occupied = occupiedCells(board);
+		Mask falling;
+		while ((falling = occupied & ((~occupied & Bits::kAllCells) >> kBoardCols)) != 0)
+		{
+			for (int color = 0; color < numGemTypes; ++color)
+			{
+				Mask& gems = m_gemMasks[color][board];
+				Mask moved = gems & falling;
+				gems = (gems & ~moved) | (moved << kBoardCols);
+			}
+			occupied = (occupied & ~falling) | (falling << kBoardCols);
+		}
+
+		//refill the holes left at the top
+		for (Mask empty = ~occupied & Bits::kAllCells; empty; empty &= empty - 1)
+		{
+			m_gemMasks[m_random[board].nextInt(numGemTypes)][board] |= empty & (~empty + 1);
+		}
+	}
+	return steps;
+}
+
+void BatchSimulator::advanceBatch(int begin, int end, int numSteps)
+{
+	for (int step = 0; step < numSteps; ++step)
+	{
+		findMoves(begin, end);
+		playMoves(begin, end);
+	}
+}
+
+void BatchSimulator::run(int numSteps, int numThreads)
+{
+	if (numThreads <= 0)
+	{
+		numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+	}
+	numThreads = min(numThreads, m_numBoards);
+
+	auto startTime = chrono::high_resolution_clock::now();
+
+	if (numThreads == 1)
+	{
+		advanceBatch(0, m_numBoards, numSteps);
+		m_numThreadsUsed = 1;
+	}
+	else
+	{
+		//one contiguous batch of boards per thread, split evenly so that no thread is left without one.
+		//The arrays aren't aligned, the threads can still share the cache line at either end of their batch
+		vector<thread> threads;
+		for (int batch = 0; batch < numThreads; ++batch)
+		{
+			int begin = static_cast<int>(static_cast<long long>(m_numBoards) * batch / numThreads);
+			int end = static_cast<int>(static_cast<long long>(m_numBoards) * (batch + 1) / numThreads);
+			threads.push_back(thread([this, begin, end, numSteps]() { advanceBatch(begin, end, numSteps); }));
+		}
+		for (auto& worker : threads)
+		{
+			worker.join();
+		}
+		m_numThreadsUsed = static_cast<int>(threads.size());
+	}
+
+	auto endTime = chrono::high_resolution_clock::now();
+	m_elapsed_s += chrono::duration<double>(endTime - startTime).count();
+}
+
+long long BatchSimulator::getGamesFinished() const
+{
+	long long games = 0;
+	for (int board = 0; board < m_numBoards; ++board)
+	{
+		games += m_gamesFinished[board];
+	}
+	return games;
+}
+
+double BatchSimulator::getAverageScore() const
+{
+	long long games = getGamesFinished();
+	if (games == 0)
+		return 0.0;
+
+	long long totalScore = 0;
+	for (int board = 0; board < m_numBoards; ++board)
+	{
+		totalScore += m_finishedScores[board];
+	}
+	return static_cast<double>(totalScore) / games;
+}
+
+void BatchSimulator::printStats() const
+{
+	long long games = getGamesFinished();
+	double gamesPerSecond = m_elapsed_s > 0.0 ? games / m_elapsed_s : 0.0;
+
+	cout << "batch: " << m_numBoards << " boards, " << m_numThreadsUsed << " threads, " << m_config.numGemTypes << " gem types" << endl;
+	cout << "batch: " << games << " games in " << m_elapsed_s << " s, " << gamesPerSecond << " games/s" << endl;
+	cout << "batch: average score " << getAverageScore() << endl;
+}
@@ -0,0 +1,77 @@
+#ifndef BATCH_SIMULATOR_H
+#define BATCH_SIMULATOR_H
+
+#include "Board.h"
+#include "BitBoard.h"
+#include "Random.h"
+
+#include <vector>
+
+// Game rules the batch simulator plays by, exposed so they can be tuned
+struct BatchSimConfig
+{
+	int		numGemTypes;
+	float	gameTime_s;
+	float	swapTime_s;			// time the swap animation takes on the real board
+	float	cascadeStepTime_s;	// time it takes the gems to fall after a match
+	int		crossMultiplier;	// a group of runs containing a cross pattern scores this many times its size
+
+	BatchSimConfig() :
+		numGemTypes(5),
+		gameTime_s(static_cast<float>(kTotalTime_s)),
+		swapTime_s(0.25f),
+		cascadeStepTime_s(0.5f),
+		crossMultiplier(2)
+	{
+	}
+};
+
+// Plays full games on many independent boards at once, without animations: every step each board
+// makes one random valid swap and resolves the whole cascade instantly, and the game clock is
+// advanced by the time the animations would have taken.
+// Boards are stored as a structure of arrays, element i of every array belongs to board i, and
+// contiguous batches of boards can be advanced by different threads without sharing any state
+// (only the cache lines at the ends of the batches).
+class BatchSimulator
+{
+public:
+	typedef BitBoard<kBoardRows, kBoardCols> Bits;
+	typedef Bits::Mask Mask;
+
+private:
+	BatchSimConfig m_config;
+	int m_numBoards;
+
+	std::vector<Mask>		m_gemMasks[Bits::kMaxGemTypes];
+	std::vector<Mask>		m_validRight;
+	std::vector<Mask>		m_validDown;
+	std::vector<int>		m_scores;
+	std::vector<float>		m_timeLeft_s;
+	std::vector<Random>		m_random;
+	std::vector<int>		m_gamesFinished;
+	std::vector<long long>	m_finishedScores;
+
+	double	m_elapsed_s;
+	int		m_numThreadsUsed;
+
+	Mask	occupiedCells(int board) const;
+
+	void	newGame(int board);
+	void	findMoves(int begin, int end);
+	void	playMoves(int begin, int end);
+	int		resolveCascades(int board);
+	void	advanceBatch(int begin, int end, int numSteps);
+
+public:
+	BatchSimulator(int numBoards, const BatchSimConfig& config, uint64_t seed);
+
+	// Every board makes numSteps moves. numThreads <= 0 uses one thread per core
+	void run(int numSteps, int numThreads);
+
+	int			getNumBoards() const { return m_numBoards; }
+	long long	getGamesFinished() const;
+	double		getAverageScore() const;
+	double		getElapsedSeconds() const { return m_elapsed_s; }
+	void		printStats() const;
+};
+#endif//BATCH_SIMULATOR_H
@@ -0,0 +1,224 @@
+#ifndef BIT_BOARD_H
+#define BIT_BOARD_H
+
+#include "BitUtils.h"
+#include "WideMask.h"
+
+#include <cstdint>
+#include <assert.h>
+
+// The constant masks of a BitBoard, computed by the compiler when the board fits in one 64-bit word
+template <int ROWS, int COLS, bool WIDE = (ROWS * COLS > 64)>
+struct BitBoardMasks
+{
+	typedef uint64_t Mask;
+
+	static const int kNumCells = ROWS * COLS;
+
+	static const Mask kAllCells		= (kNumCells == 64) ? ~0ULL : ((1ULL << (kNumCells % 64)) - 1);
+	static const Mask kRowBits		= (1ULL << COLS) - 1;
+	static const Mask kFirstColumn	= kAllCells / kRowBits;
+	static const Mask kLastColumn	= kFirstColumn << (COLS - 1);
+	// cells that can start a horizontal run of 3 (all but the last two columns)
+	static const Mask kHorizontalRunStarts = kFirstColumn * ((1ULL << (COLS - 2)) - 1);
+};
+
+// Larger boards build theirs once at startup. Each one is built from scratch, the order the
+// static members of a template get initialized in isn't specified
+template <int ROWS, int COLS>
+struct BitBoardMasks<ROWS, COLS, true>
+{
+	typedef typename MaskOf<ROWS * COLS>::Type Mask;
+
+	static const int kNumCells = ROWS * COLS;
+
+	static const Mask kAllCells;
+	static const Mask kRowBits;
+	static const Mask kFirstColumn;
+	static const Mask kLastColumn;
+	static const Mask kHorizontalRunStarts;
+
+	// the cells of columns [firstCol, lastCol] of rows [firstRow, lastRow]
+	static Mask makeRect(int firstRow, int lastRow, int firstCol, int lastCol)
+	{
+		Mask m;
+		for (int row = firstRow; row <= lastRow; ++row)
+		{
+			for (int col = firstCol; col <= lastCol; ++col)
+			{
+				m |= Mask::bit(row * COLS + col);
+			}
+		}
+		return m;
+	}
+};
+
+template <int ROWS, int COLS>
+const typename BitBoardMasks<ROWS, COLS, true>::Mask BitBoardMasks<ROWS, COLS, true>::kAllCells = makeRect(0, ROWS - 1, 0, COLS - 1);
+template <int ROWS, int COLS>
+const typename BitBoardMasks<ROWS, COLS, true>::Mask BitBoardMasks<ROWS, COLS, true>::kRowBits = makeRect(0, 0, 0, COLS - 1);
+template <int ROWS, int COLS>
+const typename BitBoardMasks<ROWS, COLS, true>::Mask BitBoardMasks<ROWS, COLS, true>::kFirstColumn = makeRect(0, ROWS - 1, 0, 0);
+template <int ROWS, int COLS>
+const typename BitBoardMasks<ROWS, COLS, true>::Mask BitBoardMasks<ROWS, COLS, true>::kLastColumn = makeRect(0, ROWS - 1, COLS - 1, COLS - 1);
+template <int ROWS, int COLS>
+const typename BitBoardMasks<ROWS, COLS, true>::Mask BitBoardMasks<ROWS, COLS, true>::kHorizontalRunStarts = makeRect(0, ROWS - 1, 0, COLS - 3);
+
+// Keeps one bit per cell for every gem color, plus masks for empty and swapping cells.
+// Cell (row, col) is bit row * COLS + col, so a whole board of up to 64 cells fits in a
+// single 64-bit word and every run of 3+ equal gems can be found with a few shifts and ANDs.
+// Larger boards use a WideMask, with the same code
+template <int ROWS, int COLS, int MAX_GEM_TYPES = 8>
+class BitBoard : public BitBoardMasks<ROWS, COLS>
+{
+public:
+	typedef BitBoardMasks<ROWS, COLS> Masks;
+	typedef typename Masks::Mask Mask;
+
+	using Masks::kNumCells;
+	using Masks::kAllCells;
+	using Masks::kRowBits;
+	using Masks::kFirstColumn;
+	using Masks::kLastColumn;
+	using Masks::kHorizontalRunStarts;
+
+	static const int kMaxGemTypes = MAX_GEM_TYPES;
+
+private:
+	static_assert(ROWS > 2 || COLS > 2, "The board is too small to hold a run of 3 gems.");
+
+	Mask m_gemMasks[kMaxGemTypes];
+	Mask m_emptyMask;
+	Mask m_swapMask;
+
+	void clearCell(Mask bit)
+	{
+		for (int i = 0; i < kMaxGemTypes; ++i)
+		{
+			m_gemMasks[i] &= ~bit;
+		}
+		m_emptyMask &= ~bit;
+		m_swapMask &= ~bit;
+	}
+
+public:
+	BitBoard() { clear(); }
+
+	static int		cellIdx(int row, int col)	{ return row * COLS + col; }
+	static int		cellRow(int idx)			{ return idx / COLS; }
+	static int		cellCol(int idx)			{ return idx % COLS; }
+	static Mask		cellBit(int row, int col)	{ return MaskOf<kNumCells>::bit(cellIdx(row, col)); }
+	static Mask		columnMask(int col)			{ return kFirstColumn << col; }
+	static Mask		rowMask(int row)			{ return kRowBits << (row * COLS); }
+
+	// marks every cell as empty
+	void clear()
+	{
+		for (int i = 0; i < kMaxGemTypes; ++i)
+		{
+			m_gemMasks[i] = 0;
+		}
+		m_emptyMask = kAllCells;
+		m_swapMask = 0;
+	}
+
+	void setGem(int row, int col, int8_t color)
+	{
+		assert(color >= 0 && color < kMaxGemTypes);
+		Mask bit = cellBit(row, col);
+		clearCell(bit);
+		m_gemMasks[color] |= bit;
+	}
+	void setEmpty(int row, int col)
+	{
+		Mask bit = cellBit(row, col);
+		clearCell(bit);
+		m_emptyMask |= bit;
+	}
+	void setSwapping(int row, int col)
+	{
+		Mask bit = cellBit(row, col);
+		clearCell(bit);
+		m_swapMask |= bit;
+	}
+
+	Mask getGemMask(int color) const	{ assert(color >= 0 && color < kMaxGemTypes); return m_gemMasks[color]; }
+	const Mask* getGemMasks() const		{ return m_gemMasks; }
+	Mask getEmptyMask() const			{ return m_emptyMask; }
+	Mask getSwapMask() const			{ return m_swapMask; }
+	Mask getStaticMask() const			{ return kAllCells & ~(m_emptyMask | m_swapMask); }
+
+	// cells of gems that are part of a horizontal run of 3 or more
+	static Mask horizontalRuns(Mask gems)
+	{
+		Mask starts = gems & (gems >> 1) & (gems >> 2) & kHorizontalRunStarts;
+		return starts | (starts << 1) | (starts << 2);
+	}
+	// cells of gems that are part of a vertical run of 3 or more
+	static Mask verticalRuns(Mask gems)
+	{
+		Mask starts = gems & (gems >> COLS) & (gems >> (2 * COLS));
+		return starts | (starts << COLS) | (starts << (2 * COLS));
+	}
+	static Mask runs(Mask gems) { return horizontalRuns(gems) | verticalRuns(gems); }
+
+	// all the static gems that are part of a run, for every color
+	Mask findMatches(int numGemTypes) const
+	{
+		assert(numGemTypes <= kMaxGemTypes);
+		Mask matches = 0;
+		for (int color = 0; color < numGemTypes; ++color)
+		{
+			matches |= runs(m_gemMasks[color]);
+		}
+		return matches;
+	}
+
+	// grows seeds through the 4-connected cells of allowed
+	static Mask floodFill(Mask seeds, Mask allowed)
+	{
+		Mask filled = seeds & allowed;
+		Mask grown;
+		while ((grown = (filled | ((filled << 1) & ~kFirstColumn) | ((filled >> 1) & ~kLastColumn) | 
+						(filled << COLS) | (filled >> COLS)) & allowed) != filled)
+		{
+			filled = grown;
+		}
+		return filled;
+	}
+
+	bool isMatched(int row, int col, int8_t color) const
+	{
+		return (runs(getGemMask(color)) & cellBit(row, col)) != 0;
+	}
+
+	// the horizontal and vertical runs of 3+ going through (row, col), 0 when there is none
+	void getRunsThrough(int row, int col, int8_t color, Mask& horizontal, Mask& vertical) const
+	{
+		Mask gems = getGemMask(color);
+		Mask bit = cellBit(row, col);
+
+		Mask hRuns = horizontalRuns(gems);
+		horizontal = hRuns & bit;
+		if (horizontal)
+		{
+			Mask grown;
+			while ((grown = (horizontal | ((horizontal << 1) & ~kFirstColumn) | ((horizontal >> 1) & ~kLastColumn)) & hRuns) != horizontal)
+			{
+				horizontal = grown;
+			}
+		}
+
+		Mask vRuns = verticalRuns(gems);
+		vertical = vRuns & bit;
+		if (vertical)
+		{
+			Mask grown;
+			while ((grown = (vertical | (vertical << COLS) | (vertical >> COLS)) & vRuns) != vertical)
+			{
+				vertical = grown;
+			}
+		}
+	}
+};
+#endif//BIT_BOARD_H
@@ -0,0 +1,59 @@
+#ifndef BIT_UTILS_H
+#define BIT_UTILS_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace BitUtils
+{
+	inline int countBits(uint64_t v)
+	{
+		v = v - ((v >> 1) & 0x5555555555555555ULL);
+		v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+		v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+	}
+
+	// index of the lowest set bit, v must not be 0
+	inline int lowestBit(uint64_t v)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx;
+	#if defined(_M_X64)
+		_BitScanForward64(&idx, v);
+		return static_cast<int>(idx);
+	#else
+		if (_BitScanForward(&idx, static_cast<unsigned long>(v)))
+			return static_cast<int>(idx);
+		_BitScanForward(&idx, static_cast<unsigned long>(v >> 32));
+		return static_cast<int>(idx) + 32;
+	#endif
+#else
+		return __builtin_ctzll(v);
+#endif
+	}
+
+	// index of the highest set bit, v must not be 0
+	inline int highestBit(uint64_t v)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx;
+	#if defined(_M_X64)
+		_BitScanReverse64(&idx, v);
+		return static_cast<int>(idx);
+	#else
+		if (_BitScanReverse(&idx, static_cast<unsigned long>(v >> 32)))
+			return static_cast<int>(idx) + 32;
+		_BitScanReverse(&idx, static_cast<unsigned long>(v));
+		return static_cast<int>(idx);
+	#endif
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+};
+
+#endif//BIT_UTILS_H
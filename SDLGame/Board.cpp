@@ -1,38 +1,36 @@
 #include "Board.h"
 #include "GraphicsMgr.h"
+#include "Profiler.h"
+#include "BoardSnapshot.h"
 #include "AssetMgr.h"
+#include "BoardGenerator.h"
+#include "BoardPool.h"
 #include "Common.h"
 
 #include <SDL.h>
 
 #include <ctime>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 
 #include <stdlib.h>
 
 using namespace std;
 using namespace Utils;
 
+static const float kSwapSpeed = 4.f * kPixelsPerMeters;
+static const float kFallStartSpeed = 4.f * kPixelsPerMeters;
+static const float kFallAcceleration = 9.81f * kPixelsPerMeters;
 
-template <typename T>
-static void removeElement(std::vector<T>& vect, int idx)
-{
-	//Note: order of the elements is changed
-	//swap with the last one and release the last element
-
-	assert(idx >= 0 && idx < static_cast<int>(vect.size()));
-	int lastIdx = vect.size() - 1;
-	if (lastIdx != idx)
-	{
-		vect[idx] = vect[lastIdx];
-	}
-	vect.pop_back();
-}
-
-Board::Board(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int boardBoundsYMin, int boardW, int boardH, 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::BasicBoard(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int boardBoundsYMin, int boardW, int boardH, 
 				AssetMgr* pAssetMgr, GraphicsMgr* pGfxMgr) :
+	m_pBoardPool(nullptr),
 	m_pAssetMgr(pAssetMgr),
 	m_pGfxMgr(pGfxMgr)
 {
+	assert(numGemTypes > 0 && numGemTypes <= GemsBitBoard::kMaxGemTypes);
 	m_numGemTypes = numGemTypes;
 
 	m_gemW = gemW;
@@ -46,8 +44,8 @@ Board::Board(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int board
 	m_boardBoundsYMin = boardBoundsYMin; 
 	m_boardBoundsYMax = boardBoundsYMin + boardH; 
 
-	m_paddingW =  (boardW - kBoardCols * gemW) / kBoardCols;
-	m_paddingH =  (boardH - kBoardRows * gemH) / kBoardRows;
+	m_paddingW =  (boardW - COLS * gemW) / COLS;
+	m_paddingH =  (boardH - ROWS * gemH) / ROWS;
 	
 	m_tileSizeW = gemW + m_paddingW;
 	m_tileSizeH = gemH + m_paddingH;
@@ -55,7 +53,14 @@ Board::Board(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int board
 	init();
 }
 
-void Board::init()
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::init()
+{
+	init(static_cast<uint64_t>(time(nullptr)));
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::init(uint64_t seed)
 {
 	m_boardState = EBS_FIRST_SELECTION;
 	
@@ -66,81 +71,157 @@ void Board::init()
 	m_time_ms = 0;
 	m_score = 0;
 	
-	m_swappingGemPairs.clear();
+	m_gems.clear();
 	m_swappingGems.clear();
-	m_fallingGems.clear();
-	for (size_t i = 0, n = m_fallingGems.size(); i < n; ++i)
+	for (int col = 0; col < COLS; ++col)
 	{
-		m_fallingGems[i].clear();
+		m_fallingGems[col].clear();
 	}
-	m_fallingGemsStartIdx.clear();
-	m_fallingGemsEndIdx.clear();
+	m_landings.clear();
+	m_fallTime_s = 0.0;
+	m_prevFallTime_s = 0.0;
+	m_landingsDirtyCols = 0;
+	m_stackedLandingCols = 0;
+	m_emptiedCells = 0;
+	m_bPlayerHasMoved = false;
 
-	//allocate some memory to avoid too many reallocations
-	m_swappingGemPairs.reserve(5);
-	m_swappingGems.reserve(10);
-	m_fallingGems.resize(kBoardCols);
+	m_bHintVisible = false;
 
-	for (size_t i = 0, n = kBoardCols; i < n; ++i)
+	typename Pool::Entry newBoard;
+	if (!m_pBoardPool || !m_pBoardPool->take(seed, newBoard))
 	{
-		m_fallingGems[i].resize(kBoardRowsPlusOne);
+		Pool::generate(seed, m_numGemTypes, newBoard);
 	}
-	
-	m_fallingGemsStartIdx.resize(kBoardRowsPlusOne);
-	m_fallingGemsEndIdx.resize(kBoardRowsPlusOne);
-	
-	std::fill (m_fallingGemsStartIdx.begin(), m_fallingGemsStartIdx.end(), 0);
-	std::fill (m_fallingGemsEndIdx.begin(), m_fallingGemsEndIdx.end(), 0);
-	m_bPlayerHasMoved = false;
+	m_random = newBoard.random;
+	dropNewGems(newBoard.layout);
+}
 
-	srand((unsigned int)time(nullptr));
-	//srand((unsigned int)0);
-	for (int row = 0; row < kBoardRows; ++row)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::dropNewGems(const Layout& layout)
+{
+	//add from bottom to the top
+	for (int row = ROWS - 1; row >= 0; --row)
 	{
-		for (int col = 0; col < kBoardCols; ++col)
+		for (int col = 0; col < COLS; ++col)
 		{
-			bool eraseVertical = false;
-			bool eraseHorizontal = false;
-			do 
-			{
-				//@TODO: use a uniform distribution(not just here)
-				mat(row, col).color = rand() % m_numGemTypes;
+			Point pos = getTileCenter(row - 2 * ROWS - col, col);
+			addFallingGem(col, pos.y, layout.cells[row][col]);
+			setCellColor(row, col, kEmptyCellColor);
+		}
+	}
+}
 
-				//This can be optimized since we only need to know if the chain is 
-				//longer than 3 gems, we don't need to know exactly how long it is
-				int rowStart	= checkLineChain(row, col, /*axisX =*/false, /*positiveDir =*/ false);
-				int colStart	= checkLineChain(row, col, /*axisX =*/true, /*positiveDir =*/ false);
 
-				int verticalGemChain	= row - rowStart + 1; 
-				int horizontalGemChain	= col - colStart + 1; 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::~BasicBoard()
+{
+}
 
-				eraseVertical	= verticalGemChain	>= 3;
-				eraseHorizontal	= horizontalGemChain >= 3;
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::reshuffle()
+{
+	assert(isSettled());
+	m_boardState = EBS_FIRST_SELECTION;
+	m_bHintVisible = false;
+	Layout layout;
+	BoardGenerator::generate(m_random, m_numGemTypes, layout);
+	dropNewGems(layout);
+}
 
-			} while (eraseVertical || eraseHorizontal);
-		}
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+bool BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::isSettled() const
+{
+	if (!m_swappingGems.empty())
+		return false;
+
+	for (int col = 0; col < COLS; ++col)
+	{
+		if (!m_fallingGems[col].empty())
+			return false;
 	}
+	return m_bits.getStaticMask() == GemsBitBoard::kAllCells;
+}
 
-	//add from bottom to the top
-	for (int row = kBoardRows - 1; row >= 0; --row)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+bool BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::hasValidMove()
+{
+	m_moveIndex.refresh(m_bits, m_numGemTypes);
+	return m_moveIndex.hasValidMove();
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getValidMoves(std::vector<Move>& moves)
+{
+	moves.clear();
+	m_moveIndex.refresh(m_bits, m_numGemTypes);
+
+	for (Mask bits = m_moveIndex.getValidRight(); bits; bits &= bits - 1)
 	{
-		for (int col = 0; col < kBoardCols; ++col)
-		{
-			Point pos = getTileCenter(row - 2 * kBoardRows - col, col);
-			addFallingGem(col, pos.y, mat(row, col).color);
-			mat(row, col).color = kEmptyCellColor;
-		}
+		int idx = BitUtils::lowestBit(bits);
+		int row = GemsBitBoard::cellRow(idx);
+		int col = GemsBitBoard::cellCol(idx);
+		moves.push_back(Move(row, col, row, col + 1));
+	}
+	for (Mask bits = m_moveIndex.getValidDown(); bits; bits &= bits - 1)
+	{
+		int idx = BitUtils::lowestBit(bits);
+		int row = GemsBitBoard::cellRow(idx);
+		int col = GemsBitBoard::cellCol(idx);
+		moves.push_back(Move(row, col, row + 1, col));
 	}
 }
 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+bool BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getHint(Move& move)
+{
+	m_moveIndex.refresh(m_bits, m_numGemTypes);
 
-Board::~Board()
+	Mask right = m_moveIndex.getValidRight();
+	Mask down = m_moveIndex.getValidDown();
+	if (right)
+	{
+		int idx = BitUtils::lowestBit(right);
+		move = Move(GemsBitBoard::cellRow(idx), GemsBitBoard::cellCol(idx), GemsBitBoard::cellRow(idx), GemsBitBoard::cellCol(idx) + 1);
+		return true;
+	}
+	if (down)
+	{
+		int idx = BitUtils::lowestBit(down);
+		move = Move(GemsBitBoard::cellRow(idx), GemsBitBoard::cellCol(idx), GemsBitBoard::cellRow(idx) + 1, GemsBitBoard::cellCol(idx));
+		return true;
+	}
+	return false;
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::setCellColor(int row, int col, int8_t color)
 {
+	if ((mat(row, col).color == kEmptyCellColor) != (color == kEmptyCellColor))
+	{
+		//the gems falling in this column may land somewhere else now
+		m_landingsDirtyCols |= ColumnSet::bit(col);
+	}
+	mat(row, col).color = color;
+	m_moveIndex.invalidate(GemsBitBoard::cellBit(row, col));
+	if (color == kEmptyCellColor)
+	{
+		m_bits.setEmpty(row, col);
+		m_emptiedCells |= GemsBitBoard::cellBit(row, col);
+	}
+	else if (color == kSwapCellColor)
+	{
+		m_bits.setSwapping(row, col);
+	}
+	else
+	{
+		m_bits.setGem(row, col, color);
+	}
 }
 
-int Board::checkLineChain(int startRow, int startCol, bool axisX, bool positiveDir) const
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::checkLineChain(int startRow, int startCol, bool axisX, bool positiveDir) const
 {
-	int upperLimit = axisX ? kBoardCols : kBoardRows;
+	int upperLimit = axisX ? COLS : ROWS;
 	int inc = positiveDir ? 1 : -1;
 	int limit = axisX ? startCol : startRow;
 	int8_t color = mat(startRow, startCol).color;
@@ -152,7 +233,7 @@ int Board::checkLineChain(int startRow, int startCol, bool axisX, bool positiveD
 		if (positiveDir ? limit >= upperLimit : limit < 0)
 			break;
 
-		Cell& cell = axisX ? mat(startRow, limit) : mat(limit, startCol);
+		const Cell& cell = axisX ? mat(startRow, limit) : mat(limit, startCol);
 		if (cell.color != color || !isStaticGem(cell))
 		{
 			break;
@@ -161,17 +242,20 @@ int Board::checkLineChain(int startRow, int startCol, bool axisX, bool positiveD
 	limit -= inc;
 	return limit;
 }
-void Board::solveFallAtPos(int checkedRow, int checkedCol)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::solveFallAtPos(int checkedRow, int checkedCol)
 {
 	int positionsToFall = 0;
-	for (int row = checkedRow + 1; row < kBoardRows; ++row)
+	for (int row = checkedRow + 1; row < ROWS; ++row)
 	{
 		if (mat(row, checkedCol).color != kEmptyCellColor)
 			break;
 		++positionsToFall;
 	}
-	
-	if (positionsToFall == 0)
+
+	//some of the empty cells below might already be claimed by gems that are falling into them
+	positionsToFall -= countFallingGemsBelow(checkedCol, getTileCenterY(checkedRow));
+	if (positionsToFall <= 0)
 		return;
 
 	for (int row = checkedRow; row >= -positionsToFall; --row)
@@ -179,40 +263,65 @@ void Board::solveFallAtPos(int checkedRow, int checkedCol)
 		int8_t color;
 		if (row >= 0)
 		{
-			int8_t& gemColor = mat(row, checkedCol).color;
+			int8_t gemColor = mat(row, checkedCol).color;
 			if (gemColor == kEmptyCellColor || gemColor == kSwapCellColor)
 			{
 				break;
 			}
 			color = gemColor;
-			gemColor = kEmptyCellColor;
+			setCellColor(row, checkedCol, kEmptyCellColor);
 		}
 		else 
 		{
-			color = rand() % m_numGemTypes;
+			color = randomGemColor();
 		}
 		Point pos = getTileCenter(row, checkedCol);
 		addFallingGem(checkedCol, pos.y, color);
 	}
 }
-bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+bool BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 {
-	int rowStart	= checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/false, /*positiveDir =*/ false);
-	int rowEnd		= checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/false, /*positiveDir =*/ true);
-	int colStart	= checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/true, /*positiveDir =*/ false);
-	int colEnd		= checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/true, /*positiveDir =*/ true);
-	
+	PROFILE_SCOPE(EPS_BOARD_SOLVING);
+	assert(isStaticGem(mat(modifiedCellRow, modifiedCellCol)));
+
+	Mask horizontalRun;
+	Mask verticalRun;
+	m_bits.getRunsThrough(modifiedCellRow, modifiedCellCol, mat(modifiedCellRow, modifiedCellCol).color, horizontalRun, verticalRun);
+	//a single cell is quicker to check on the bitboard, a full scan must find the same runs
+	BOARD_CROSS_CHECK(!((horizontalRun | verticalRun) & ~GemsRunKernel::findRuns(getCellColors())));
+
+	bool eraseVertical		= verticalRun != 0;
+	bool eraseHorizontal	= horizontalRun != 0;
+
+	int rowStart	= modifiedCellRow;
+	int rowEnd		= modifiedCellRow;
+	int colStart	= modifiedCellCol;
+	int colEnd		= modifiedCellCol;
+	if (eraseVertical)
+	{
+		rowStart	= GemsBitBoard::cellRow(BitUtils::lowestBit(verticalRun));
+		rowEnd		= GemsBitBoard::cellRow(BitUtils::highestBit(verticalRun));
+		BOARD_CROSS_CHECK(rowStart == checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/false, /*positiveDir =*/ false));
+		BOARD_CROSS_CHECK(rowEnd == checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/false, /*positiveDir =*/ true));
+	}
+	if (eraseHorizontal)
+	{
+		colStart	= GemsBitBoard::cellCol(BitUtils::lowestBit(horizontalRun));
+		colEnd		= GemsBitBoard::cellCol(BitUtils::highestBit(horizontalRun));
+		BOARD_CROSS_CHECK(colStart == checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/true, /*positiveDir =*/ false));
+		BOARD_CROSS_CHECK(colEnd == checkLineChain(modifiedCellRow, modifiedCellCol, /*axisX =*/true, /*positiveDir =*/ true));
+	}
+
 	int verticalGemChain	= rowEnd - rowStart + 1; 
 	int horizontalGemChain	= colEnd - colStart + 1; 
 	
-	bool eraseVertical		= verticalGemChain	>= 3;
-	bool eraseHorizontal	= horizontalGemChain >= 3;
 	int score = 0;
 	if (eraseVertical)
 	{
 		for (int row = rowStart; row <= rowEnd; ++row)
 		{
-			mat(row, modifiedCellCol).color = kEmptyCellColor;
+			setCellColor(row, modifiedCellCol, kEmptyCellColor);
 		}
 		//make the upper gems fall
 		for (int row = rowStart - 1; row >= -verticalGemChain; --row)
@@ -220,17 +329,17 @@ bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 			int8_t color;
 			if (row >= 0)
 			{
-				int8_t& gemColor = mat(row, modifiedCellCol).color;
+				int8_t gemColor = mat(row, modifiedCellCol).color;
 				if (gemColor == kEmptyCellColor || gemColor == kSwapCellColor)
 				{
 					break;
 				}
 				color = gemColor;
-				gemColor = kEmptyCellColor;
+				setCellColor(row, modifiedCellCol, kEmptyCellColor);
 			}
 			else 
 			{
-				color = rand() % m_numGemTypes;
+				color = randomGemColor();
 			}
 			Point pos = getTileCenter(row, modifiedCellCol);
 			addFallingGem(modifiedCellCol, pos.y, color);
@@ -243,7 +352,7 @@ bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 	{
 		for (int col = colStart; col <= colEnd; ++col)
 		{
-			mat(modifiedCellRow, col).color = kEmptyCellColor;
+			setCellColor(modifiedCellRow, col, kEmptyCellColor);
 		}
 
 		//make the upper gems fall
@@ -259,23 +368,23 @@ bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 				int8_t color;
 				if (row >= 0)
 				{
-					int8_t& gemColor = mat(row, col).color;
+					int8_t gemColor = mat(row, col).color;
 					if (gemColor == kEmptyCellColor || gemColor == kSwapCellColor)
 					{
 						break;
 					}
 					color = gemColor;
-					gemColor = kEmptyCellColor;
+					setCellColor(row, col, kEmptyCellColor);
 				}
 				else 
 				{
-					color = rand() % m_numGemTypes;
+					color = randomGemColor();
 				}
 				Point pos = getTileCenter(row, col);
 				addFallingGem(col, pos.y, color);
 			}
 		}
-		score += verticalGemChain;
+		score += horizontalGemChain;
 	}
 
 	if (eraseHorizontal && eraseVertical)
@@ -286,7 +395,7 @@ bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 	}
 
 	bool bHasErased = eraseHorizontal || eraseVertical;
-	if (bHasErased)
+	if (bHasErased && m_pAssetMgr)
 	{
 		m_pAssetMgr->playErasedSound();
 	}
@@ -294,7 +403,101 @@ bool Board::solveBoardAtPos(int modifiedCellRow, int modifiedCellCol)
 	
 	return bHasErased;
 }
-bool Board::solveSelectionValidity()
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+typename BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::CascadeStep BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::resolveCascadeStep(Mask regionMask)
+{
+	PROFILE_SCOPE(EPS_BOARD_SOLVING);
+	CascadeStep step;
+	step.clearedMask = 0;
+	step.score = 0;
+	step.numFallingGems = 0;
+	step.numRefills = 0;
+
+	//the runs of all the colors in one pass over the cells, split by color below
+	Mask allHorizontal;
+	Mask allVertical;
+	GemsRunKernel::findRuns(getCellColors(), allHorizontal, allVertical);
+	BOARD_CROSS_CHECK((allHorizontal | allVertical) == m_bits.findMatches(m_numGemTypes));
+
+	for (int color = 0; color < m_numGemTypes; ++color)
+	{
+		Mask gems = m_bits.getGemMask(color);
+		Mask horizontal = allHorizontal & gems;
+		Mask vertical = allVertical & gems;
+		Mask matched = horizontal | vertical;
+		if (!(matched & regionMask))
+			continue;
+
+		//only keep the groups of runs that touch the region
+		Mask cleared = GemsBitBoard::floodFill(matched & regionMask, matched);
+		
+		//a group containing a cross pattern scores double
+		Mask crosses = GemsBitBoard::floodFill(horizontal & vertical & cleared, cleared);
+		step.score += BitUtils::countBits(cleared) + BitUtils::countBits(crosses);
+		step.clearedMask |= cleared;
+	}
+	step.numCleared = BitUtils::countBits(step.clearedMask);
+
+	for (int col = 0; col < COLS; ++col)
+	{
+		Mask columnCleared = step.clearedMask & GemsBitBoard::columnMask(col);
+		step.columnHoles[col] = BitUtils::countBits(columnCleared);
+		if (!columnCleared)
+			continue;
+
+		for (Mask bits = columnCleared; bits; bits &= bits - 1)
+		{
+			setCellColor(GemsBitBoard::cellRow(BitUtils::lowestBit(bits)), col, kEmptyCellColor);
+		}
+
+		//walk up from the lowest cleared cell, every static gem above a hole starts falling.
+		//An empty or swapping cell blocks the fall, the holes below it are refilled by update()
+		int holes = 0;
+		bool bFalling = false;
+		for (int row = GemsBitBoard::cellRow(BitUtils::highestBit(columnCleared)); row >= 0; --row)
+		{
+			if (columnCleared & GemsBitBoard::cellBit(row, col))
+			{
+				++holes;
+				bFalling = true;
+			}
+			else if (bFalling)
+			{
+				int8_t color = mat(row, col).color;
+				if (color == kEmptyCellColor || color == kSwapCellColor)
+				{
+					bFalling = false;
+					holes = 0;
+				}
+				else
+				{
+					setCellColor(row, col, kEmptyCellColor);
+					addFallingGem(col, getTileCenterY(row), color);
+					++step.numFallingGems;
+				}
+			}
+		}
+
+		if (bFalling)
+		{
+			for (int row = -1; row >= -holes; --row)
+			{
+				addFallingGem(col, getTileCenterY(row), randomGemColor());
+			}
+			step.numRefills += holes;
+		}
+	}
+
+	m_score += step.score;
+	if (step.numCleared > 0 && m_pAssetMgr)
+	{
+		m_pAssetMgr->playErasedSound();
+	}
+	return step;
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+bool BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::solveSelectionValidity()
 {
 	if (m_boardState == EBS_SECOND_SELECTION && mat(m_lastClickedRow, m_lastClickedCol).color != m_lastClickedColor)
 	{
@@ -304,7 +507,8 @@ bool Board::solveSelectionValidity()
 	}
 	return true;
 }
-void Board::mouseEvent(int x, int y, bool bMouseDown)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::mouseEvent(int x, int y, bool bMouseDown)
 {
 	if (x >= m_boardBoundsXMin && x < m_boardBoundsXMax &&
 		y >= m_boardBoundsYMin && y < m_boardBoundsYMax)
@@ -367,7 +571,11 @@ void Board::mouseEvent(int x, int y, bool bMouseDown)
 			{
 				swapGems(m_lastClickedRow, m_lastClickedCol, rowToSwapWith, colToSwapWith, true);
 				m_bPlayerHasMoved = true;
-				m_pAssetMgr->playMovedSound();
+				m_bHintVisible = false;
+				if (m_pAssetMgr)
+				{
+					m_pAssetMgr->playMovedSound();
+				}
 			}
 
 			// don't select and immediately unselect gem if clicked and released on the same gem
@@ -380,334 +588,606 @@ void Board::mouseEvent(int x, int y, bool bMouseDown)
 		}
 	}
 }
-void Board::swapGems(int row1, int col1, int row2, int col2, bool addPair)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::swapGems(int row1, int col1, int row2, int col2, bool addPair)
 {
-	int8_t& colorGem1 = mat(row1, col1).color;
-	int8_t& colorGem2 = mat(row2, col2).color;
-	Point posGem1 = getTileCenter(row1, col1);
-	Point posGem2 = getTileCenter(row2, col2);
-	
-	int pairIdx = -1;
+	int firstIdx = m_swappingGems.size();
+	addSwappingGem(row1, col1, row2, col2);
+	addSwappingGem(row2, col2, row1, col1);
 	if (addPair)
 	{
-		pairIdx = static_cast<int>(m_swappingGemPairs.size());
-		int gem1Idx = m_swappingGems.size();
-		int gem2Idx = gem1Idx + 1;
-		m_swappingGemPairs.push_back(SwappingGemsPair(gem1Idx, gem2Idx));
+		GemHandle gem1 = m_swappingGems[firstIdx];
+		GemHandle gem2 = m_swappingGems[firstIdx + 1];
+		m_gems.partner[m_gems.slot(gem1)] = gem2;
+		m_gems.partner[m_gems.slot(gem2)] = gem1;
 	}
+	setCellColor(row1, col1, kSwapCellColor);
+	setCellColor(row2, col2, kSwapCellColor);
+}
 
-	m_swappingGems.push_back(SwappingGem(posGem1.x, posGem1.y, posGem2.x, posGem2.y, pairIdx, row2, col2, colorGem1));
-	m_swappingGems.push_back(SwappingGem(posGem2.x, posGem2.y, posGem1.x, posGem1.y, pairIdx, row1, col1, colorGem2));
-	colorGem1 = kSwapCellColor;
-	colorGem2 = kSwapCellColor;
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::addSwappingGem(int startRow, int startCol, int destRow, int destCol)
+{
+	int8_t color = mat(startRow, startCol).color;
+	assert(color != kEmptyCellColor && color != kSwapCellColor);
+	Point start = getTileCenter(startRow, startCol);
+	Point dest = getTileCenter(destRow, destCol);
+	assert((start.x == dest.x) != (start.y == dest.y));
+
+	GemHandle handle = m_gems.allocate(Gems::EGM_SWAPPING);
+	int slot = Gems::handleSlot(handle);
+	m_gems.posX[slot] = m_gems.prevPosX[slot] = static_cast<float>(start.x);
+	m_gems.posY[slot] = m_gems.prevPosY[slot] = static_cast<float>(start.y);
+	float dir = ((dest.x - start.x) + (dest.y - start.y)) > 0 ? 1.f : -1.f;
+	m_gems.velX[slot] = (start.y == dest.y) ? dir * kSwapSpeed : 0.f;
+	m_gems.velY[slot] = (start.y == dest.y) ? 0.f : dir * kSwapSpeed;
+	m_gems.targetX[slot] = static_cast<float>(dest.x);
+	m_gems.targetY[slot] = static_cast<float>(dest.y);
+	m_gems.destRow[slot] = static_cast<int8_t>(destRow);
+	m_gems.destCol[slot] = static_cast<int8_t>(destCol);
+	m_gems.color[slot] = color;
+	m_gems.partner[slot] = kInvalidGemHandle;
+	m_gems.partnerResult[slot] = Gems::EPR_NOT_FINISHED;
+	m_swappingGems.push_back(handle);
 }
 
-void Board::releasePair(int swapPairIdx)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::releaseSwappingGem(int listIdx)
 {
+	GemHandle handle = m_swappingGems[listIdx];
+	//the partner carries on alone
+	GemHandle partner = m_gems.partner[m_gems.slot(handle)];
+	if (m_gems.isAlive(partner))
 	{
-		SwappingGemsPair& pair = m_swappingGemPairs[swapPairIdx];
-		m_swappingGems[pair.getGem1Idx()].invalidatePair();
-		m_swappingGems[pair.getGem2Idx()].invalidatePair();
-	}
-	int lastIdx = m_swappingGemPairs.size() - 1; 
-	removeElement(m_swappingGemPairs, swapPairIdx);
-	if (swapPairIdx != lastIdx && !m_swappingGemPairs[swapPairIdx].hasFinished())
-	{
-		SwappingGemsPair& pair = m_swappingGemPairs[swapPairIdx];
-		m_swappingGems[pair.getGem1Idx()].m_swapPairIdx = swapPairIdx; 
-		m_swappingGems[pair.getGem2Idx()].m_swapPairIdx = swapPairIdx; 
+		m_gems.partner[m_gems.slot(partner)] = kInvalidGemHandle;
 	}
+	m_gems.release(handle);
+	m_swappingGems.removeSwapLast(listIdx);
 }
 
-
-void Board::removeSwappingGem(int idx)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::updateSwappingGems(float dt_s)
 {
-	int lastIdx = m_swappingGems.size() - 1; 
-
-	removeElement(m_swappingGems, idx);
-	if (idx != lastIdx && m_swappingGems[idx].hasValidPair())
+	//the gems added by a swap back during this pass only start moving next update
+	for (int i = 0, n = m_swappingGems.size(); i < n; ++i)
 	{
-		SwappingGemsPair& pair = m_swappingGemPairs[m_swappingGems[idx].m_swapPairIdx];
-		if (pair.getGem1Idx() == lastIdx)
+		int gem = m_gems.slot(m_swappingGems[i]);
+
+		//@TODO this might look nicer with some acceleration or with a little inertia
+		m_gems.prevPosX[gem] = m_gems.posX[gem];
+		m_gems.prevPosY[gem] = m_gems.posY[gem];
+		m_gems.posX[gem] += m_gems.velX[gem] * dt_s;
+		m_gems.posY[gem] += m_gems.velY[gem] * dt_s;
+
+		float velocity = m_gems.velX[gem] + m_gems.velY[gem];
+		float pos = m_gems.velX[gem] != 0.f ? m_gems.posX[gem] : m_gems.posY[gem];
+		float target = m_gems.velX[gem] != 0.f ? m_gems.targetX[gem] : m_gems.targetY[gem];
+		if (velocity > 0.f ? pos < target : pos > target)
+			continue;
+
+		//arrived, the gem stops and is released after the pass
+		m_gems.velX[gem] = 0.f;
+		m_gems.velY[gem] = 0.f;
+		int destRow = m_gems.destRow[gem];
+		int destCol = m_gems.destCol[gem];
+		assert(isCellSwapping(destRow, destCol));
+		setCellColor(destRow, destCol, m_gems.color[gem]);
+
+		GemHandle partner = m_gems.partner[gem];
+		bool hasPartner = partner != kInvalidGemHandle;
+		int partnerResult = m_gems.partnerResult[gem];
+
+		bool hasChained = solveBoardAtPos(destRow, destCol);
+		if (!hasChained)
 		{
-			pair.setGem1Idx(idx);
+			//solve Falling 
+			//If it has chained, solveBoardAtPos already took care of the falling
+			//A gem without a partner is coming back from a swap that didn't chain
+			if (!hasPartner || partnerResult == Gems::EPR_CHAINED)
+			{
+				solveFallAtPos(destRow, destCol);
+			}
 		}
-		else
+
+		if (hasPartner)
 		{
-			pair.setGem2Idx(idx);
+			int partnerGem = Gems::handleSlot(partner);
+			if (partnerResult != Gems::EPR_NOT_FINISHED)
+			{
+				if (!hasChained && partnerResult == Gems::EPR_DIDNT_CHAIN)
+				{
+					//neither gem made a match, both go back where they came from without a partner
+					m_gems.partner[gem] = kInvalidGemHandle;
+					m_gems.partner[partnerGem] = kInvalidGemHandle;
+					swapGems(destRow, destCol, m_gems.destRow[partnerGem], m_gems.destCol[partnerGem], false);
+				}
+			}
+			else
+			{
+				m_gems.partnerResult[partnerGem] = static_cast<uint8_t>(hasChained ? Gems::EPR_CHAINED : Gems::EPR_DIDNT_CHAIN);
+			}
+		}
+	}
+
+	for (int i = 0; i < m_swappingGems.size(); ++i)
+	{
+		int gem = m_gems.slot(m_swappingGems[i]);
+		if (m_gems.velX[gem] == 0.f && m_gems.velY[gem] == 0.f)
+		{
+			releaseSwappingGem(i);
+			// decrease i to make sure we don't skip the 
+			// element placed on top of the removed one
+			--i;	
 		}
 	}
 }
-void Board::updateSwappingGems(float dt_s)
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::updateFallingGems(float dt_s)
 {
-	for (size_t i = 0, n = m_swappingGems.size(); i < n; ++i)
+	//whatever happened since the last update happened at the current time
+	predictDirtyLandings();
+
+	//land the gems in time order, each landing happening at its own time. The gems a landing makes
+	//fall start from that time too, and land during this update if they get there before its end
+	double endTime_s = m_fallTime_s + dt_s;
+	m_prevFallTime_s = m_fallTime_s;
+	while (!m_landings.empty() && m_landings.topTime() <= endTime_s)
 	{
-		SwappingGem* gem = &m_swappingGems[i];
-		if (gem->m_bMoving)
-		{
-			//@TODO this might look nicer with some acceleration or with a little inertia
-			gem->m_pos += (gem->m_bPositiveDir ? 1.f : -1.f) * gem->m_speed * dt_s;
-			if ((gem->m_bPositiveDir && gem->m_pos >= gem->m_finalPos) ||
-				!gem->m_bPositiveDir && gem->m_pos <= gem->m_finalPos)
-			{
-				gem->m_bMoving = false;
-				assert(isCellSwapping(gem->m_destRow, gem->m_destCol));
-				mat(gem->m_destRow, gem->m_destCol).color = gem->m_color;
-				bool hasChained = solveBoardAtPos(gem->m_destRow, gem->m_destCol);
-				if (!hasChained)
-				{
-					//solve Falling 
-					//If it has chained, solveBoardAtPos already took care of the falling
+		m_fallTime_s = max(m_fallTime_s, m_landings.topTime());
+		landFallingGem(m_landings.pop());
+		predictDirtyLandings();
+	}
+	m_fallTime_s = endTime_s;
+}
 
-					bool shouldSolveFall = false;
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+float BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getFallingGemY(int gem, double time_s) const
+{
+	double t = max(time_s - m_gems.fallStartTime[gem], 0.0);
+	return static_cast<float>(m_gems.posY[gem] + m_gems.velY[gem] * t + 0.5 * kFallAcceleration * t * t);
+}
 
-					//this gem has returned and didn't chain
-					shouldSolveFall = !gem->hasValidPair();
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getFallingGemRow(int gem, double time_s) const
+{
+	int row = static_cast<int>(floor((getFallingGemY(gem, time_s) - getTileCenterY(0)) / m_tileSizeH));
+	return min(row, ROWS - 1);
+}
 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getLandingRow(int gem, Mask filled) const
+{
+	//a gem lands just above the first filled cell below the row it is in
+	int row = getFallingGemRow(gem, m_fallTime_s);
+	if (row >= 0)
+	{
+		filled &= ~((GemsBitBoard::cellBit(row, m_gems.destCol[gem]) << 1) - 1);
+	}
+	return filled ? GemsBitBoard::cellRow(BitUtils::lowestBit(filled)) - 1 : ROWS - 1;
+}
 
-					if(gem->hasValidPair())
-					{
-						SwappingGemsPair& pair = m_swappingGemPairs[gem->m_swapPairIdx];
-						if (pair.hasFinished() && !pair.isReturning() && pair.hasChained())
-						{
-							shouldSolveFall = true;
-						}
-					}
-					if (shouldSolveFall)
-					{
-						solveFallAtPos(gem->m_destRow, gem->m_destCol);
-					}
-				}
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+double BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getLandingTime(int gem, int landRow) const
+{
+	//closed form of the constant acceleration, a gem already past its cell lands right away
+	double dist = getTileCenterY(landRow) - m_gems.posY[gem];
+	double landTime_s = m_gems.fallStartTime[gem];
+	if (dist > 0.0)
+	{
+		double v0 = m_gems.velY[gem];
+		landTime_s += (sqrt(v0 * v0 + 2.0 * kFallAcceleration * dist) - v0) / kFallAcceleration;
+	}
+	return landTime_s;
+}
 
-				if (gem->hasValidPair())
-				{
-					SwappingGemsPair& pair = m_swappingGemPairs[gem->m_swapPairIdx];
-
-					if (pair.hasFinished() && !pair.isReturning())
-					{	
-						if (!hasChained && !pair.hasChained())
-						{
-							assert (pair.getGem1Idx() == i || pair.getGem2Idx() == i);
-							int otherGemIdx = pair.getGem1Idx() + pair.getGem2Idx() - i;
-							pair.setIsReturning();
-							releasePair(gem->m_swapPairIdx);
-							swapGems(gem->m_destRow, gem->m_destCol, m_swappingGems[otherGemIdx].m_destRow, m_swappingGems[otherGemIdx].m_destCol, false);
-
-							//the gem pointer is invalidated from here on since 
-							//swapGems pushes back into the vector and may reallocate its memory
-							gem = &m_swappingGems[i];
-						}
-					}
-					else
-					{
-						pair.setHasChained(hasChained);
-					}
-				}
-			}
-		}	
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::predictLandings(int col)
+{
+	const GemList<kMaxFallingGemsPerCol>& falling = m_fallingGems[col];
+	Mask filled = GemsBitBoard::columnMask(col) & ~m_bits.getEmptyMask();
+
+	//from the lowest gem to the highest one
+	std::pair<float, int> order[kMaxFallingGemsPerCol];
+	for (int i = 0; i < falling.size(); ++i)
+	{
+		int gem = Gems::handleSlot(falling[i]);
+		order[i] = std::make_pair(-getFallingGemY(gem, m_fallTime_s), gem);
 	}
-	for (size_t i = 0; i < m_swappingGems.size(); ++i)
+	std::sort(order, order + falling.size());
+
+	//a gem in the same hole as the one below it lands on top of it, once that one filled its cell. Predicting
+	//that now saves predicting the whole column again after each landing. A gem that would get there first
+	//lands right after the one below it, as it would once predicted again. It only holds while the upper gem
+	//is still above the cell filled below it by then, otherwise every gem lands on what is below it today
+	//and the column is predicted again whenever a cell is filled
+	int independentRows[kMaxFallingGemsPerCol];
+	int landRows[kMaxFallingGemsPerCol];
+	bool bStacked = true;
+	for (int i = 0; i < falling.size(); ++i)
 	{
-		if (m_swappingGems[i].m_bMoving == false)
+		int gem = order[i].second;
+		independentRows[i] = getLandingRow(gem, filled);
+		landRows[i] = independentRows[i];
+		if (i > 0 && independentRows[i] == independentRows[i - 1])
 		{
-			if (m_swappingGems[i].hasValidPair())
+			int lowerGem = order[i - 1].second;
+			int lowerRow = landRows[i - 1];
+			double lowerTime_s = m_landings.getTime(lowerGem);
+			landRows[i] = lowerRow - 1;
+			bStacked = bStacked && lowerRow >= 0 && getFallingGemRow(gem, max(m_fallTime_s, lowerTime_s)) < lowerRow;
+
+			double landTime_s = getLandingTime(gem, landRows[i]);
+			if (m_landings.wouldComeBefore(gem, landTime_s, lowerGem))
 			{
-				releasePair( m_swappingGems[i].m_swapPairIdx);
+				m_landings.scheduleAfter(gem, lowerGem);
 			}
+			else
+			{
+				m_landings.schedule(gem, landTime_s);
+			}
+		}
+		else
+		{
+			m_landings.schedule(gem, getLandingTime(gem, landRows[i]));
+		}
+	}
 
-			removeSwappingGem(i);
-			// decrease i to make sure we don't skip the 
-			// element placed on top of the removed one
-			--i;	
+	if (bStacked)
+	{
+		m_stackedLandingCols |= ColumnSet::bit(col);
+	}
+	else
+	{
+		m_stackedLandingCols &= ~ColumnSet::bit(col);
+	}
+
+	for (int i = 0; i < falling.size(); ++i)
+	{
+		int gem = order[i].second;
+		if (!bStacked && landRows[i] != independentRows[i])
+		{
+			landRows[i] = independentRows[i];
+			m_landings.schedule(gem, getLandingTime(gem, landRows[i]));
 		}
+		m_gems.destRow[gem] = static_cast<int8_t>(landRows[i]);
 	}
 }
 
-void Board::updateFallingGems(float dt_s)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::predictDirtyLandings()
 {
-	for (size_t fallCol = 0; fallCol < kBoardCols; ++fallCol)
+	while (m_landingsDirtyCols)
 	{
-		int endIdx = m_fallingGemsEndIdx[fallCol];
-		if (endIdx < m_fallingGemsStartIdx[fallCol])
-		{
-			endIdx += kBoardRowsPlusOne;
-		}
+		int col = BitUtils::lowestBit(m_landingsDirtyCols);
+		m_landingsDirtyCols &= m_landingsDirtyCols - 1;
+		predictLandings(col);
+	}
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::landFallingGem(int gem)
+{
+	int col = m_gems.destCol[gem];
+	int row = m_gems.destRow[gem];
+	int8_t color = m_gems.color[gem];
 
-		for (int i = m_fallingGemsStartIdx[fallCol], n = endIdx; i < n; ++i)
+	GemList<kMaxFallingGemsPerCol>& falling = m_fallingGems[col];
+	int idx = 0;
+	while (Gems::handleSlot(falling[idx]) != gem)
+	{
+		++idx;
+	}
+	m_gems.release(falling[idx]);
+	falling.removeOrdered(idx);
+
+	//a gem with no room left in its column is lost
+	if (row >= 0)
+	{
+		setCellColor(row, col, color);
+		//the gems stacked on this one already land on top of it
+		if (m_stackedLandingCols & ColumnSet::bit(col))
 		{
-			int idx = i % kBoardRowsPlusOne;
-			FallingGem& gem = m_fallingGems[fallCol][idx];
-			//if (gem.m_bMoving)
-			{
-				static float g_acceleration = 9.81f;
-				gem.m_speed +=  g_acceleration * kPixelsPerMeters * dt_s;
-				gem.m_posY += gem.m_speed * dt_s;
-				Point nextCellPoint = getCellByPos(gem.x(), gem.y() + m_tileSizeH);
-				int nextRow = nextCellPoint.x;
-				int col = nextCellPoint.y;
-				if (nextRow >= 0)
-				{
-					if (nextRow >= kBoardRows || mat(nextRow, col).color != kEmptyCellColor)
-					{
-						int lastEmptyRow = nextRow - 1;
-						//gem.m_bMoving = false;
-					
-						// they should stop in FirstInFirstOut order
-						// @TODO: make sure they always do
-						//assert(idx == m_fallingGemsStartIdx[fallCol] % kBoardRowsPlusOne);
-			
-						m_fallingGemsStartIdx[fallCol] = (m_fallingGemsStartIdx[fallCol] + 1) % kBoardRowsPlusOne;
-						
-						//@TODO: failsafe: make sure this never happens
-						if (lastEmptyRow >= 0)
-						{
-							mat(lastEmptyRow, col).color = gem.m_color;
-						}
-
-						if (lastEmptyRow == 0 && m_bPlayerHasMoved)
-						{
-							//m_bPlayerHasMoved is used to make sure we don't try to solve anything
-							//after the initial falling gems since everything is already solved
-							
-							//when no more gems are falling, solve all the column
-							//@TODO: This can be optimized.
-							for(int checkedRow = kBoardRows - 1; checkedRow >= 0; --checkedRow)
-							{
-								if (isStaticGem(mat(checkedRow, col)))
-								{
-									solveBoardAtPos(checkedRow, col);
-								}
-							}
-						}
-					}
-				}
-			}
+			m_landingsDirtyCols &= ~ColumnSet::bit(col);
 		}
 	}
-}
 
-void Board::addFallingGem(int col, int startY, int8_t color)
-{
-	m_fallingGems[col][m_fallingGemsEndIdx[col]].init(getTileCenterX(col), startY, color);
-	m_fallingGemsEndIdx[col] = (m_fallingGemsEndIdx[col] + 1) % kBoardRowsPlusOne;
+	if (row == 0 && m_bPlayerHasMoved)
+	{
+		//m_bPlayerHasMoved is used to make sure we don't try to solve anything
+		//after the initial falling gems since everything is already solved
+		
+		//when no more gems are falling, solve all the runs going through the column
+		resolveCascadeStep(GemsBitBoard::columnMask(col));
+	}
+
+	//the landings are predicted before each one, so anything dirty now comes from the cascade. It can make gems
+	//of other columns land before the ones chained after this landing: those are predicted again too
+	if (m_landingsDirtyCols)
+	{
+		m_landingsDirtyCols |= ColumnSet::bit(col);
+	}
+
+	//a column can be left with holes once its last gem landed, e.g. when a gem was lost
+	Mask columnHoles = m_bits.getEmptyMask() & GemsBitBoard::columnMask(col);
+	if (falling.empty() && columnHoles)
+	{
+		m_emptiedCells |= columnHoles;
+	}
 }
 
-void Board::update(float dt_ms)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::refillEmptiedColumns()
 {
-	//(this is a fix for a corner-case where you erase some gems while others are still falling on the same column)
-	//@TODO: fix this in a nicer way 
-	for (size_t col = 0; col < kBoardCols; ++col)
+	typename ColumnSet::Type cols = 0;
+	for (Mask bits = m_emptiedCells; bits; bits &= bits - 1)
 	{
-		int endIdx = m_fallingGemsEndIdx[col];
-		if (endIdx < m_fallingGemsStartIdx[col])
+		cols |= ColumnSet::bit(GemsBitBoard::cellCol(BitUtils::lowestBit(bits)));
+	}
+
+	for (; cols; cols &= cols - 1)
+	{
+		int col = BitUtils::lowestBit(cols);
+		//the gems already falling in will fill the holes, the column is looked at again once they landed
+		if (!m_fallingGems[col].empty())
+			continue;
+
+		m_emptiedCells &= ~GemsBitBoard::columnMask(col);
+		Mask holes = m_bits.getEmptyMask() & GemsBitBoard::columnMask(col);
+		while (holes)
 		{
-			endIdx += kBoardRowsPlusOne;
+			//from the bottom to the top
+			int row = GemsBitBoard::cellRow(BitUtils::highestBit(holes));
+			holes &= ~GemsBitBoard::cellBit(row, col);
+			Point pos = getTileCenter(row - ROWS, col);
+			addFallingGem(col, pos.y, randomGemColor());
 		}
-		int totalFalling = endIdx - m_fallingGemsStartIdx[col];
-		if (totalFalling == 0)
+	}
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::countFallingGemsBelow(int col, int y) const
+{
+	const GemList<kMaxFallingGemsPerCol>& falling = m_fallingGems[col];
+	int count = 0;
+	for (int i = 0; i < falling.size(); ++i)
+	{
+		if (static_cast<int>(getFallingGemY(Gems::handleSlot(falling[i]), m_fallTime_s)) > y)
 		{
-			for(int row = kBoardRows - 1; row >= 0; --row)
-			{
-				if (mat(row, col).color == kEmptyCellColor)
-				{
-					int8_t color = rand() % m_numGemTypes;
-					Point pos = getTileCenter(row - kBoardRows, col);
-					addFallingGem(col, pos.y, color);	
-				}
-			}
+			++count;
 		}
 	}
+	return count;
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::addFallingGem(int col, int startY, int8_t color)
+{
+	GemHandle handle = m_gems.allocate(Gems::EGM_FALLING);
+	int slot = Gems::handleSlot(handle);
+	m_gems.posX[slot] = m_gems.prevPosX[slot] = static_cast<float>(getTileCenterX(col));
+	m_gems.posY[slot] = m_gems.prevPosY[slot] = static_cast<float>(startY);
+	m_gems.velX[slot] = 0.f;
+	m_gems.velY[slot] = kFallStartSpeed;
+	m_gems.color[slot] = color;
+	m_gems.destRow[slot] = ROWS - 1;
+	m_gems.destCol[slot] = static_cast<int8_t>(col);
+	m_gems.fallStartTime[slot] = m_fallTime_s;
+	m_fallingGems[col].push_back(handle);
+	m_landingsDirtyCols |= ColumnSet::bit(col);
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::update(float dt_ms)
+{
+	//the holes nothing is falling into, e.g. when gems got erased while others were still falling in the same column
+	refillEmptiedColumns();
 
 	if (m_bGameRunning)
 	{
-		m_time_ms += static_cast<int>(dt_ms);
+		m_time_ms += dt_ms;
 	}
 	float dt_s = dt_ms * 0.001f;
 
-	updateSwappingGems(dt_s);
-	updateFallingGems(dt_s);
+	{
+		PROFILE_SCOPE(EPS_BOARD_SWAPPING);
+		updateSwappingGems(dt_s);
+	}
+	{
+		PROFILE_SCOPE(EPS_BOARD_FALLING);
+		updateFallingGems(dt_s);
+	}
 
+	PROFILE_SCOPE(EPS_BOARD_SOLVING);
 	solveSelectionValidity();
+
+	//a board without any possible match can't be played, drop a new one
+	if (isSettled() && !hasValidMove())
+	{
+		reshuffle();
+	}
 }
 
 
-void Board::render(SDL_Renderer* renderer)
+// FNV-1a
+static void hashValue(uint32_t& hash, uint32_t value)
 {
-	if (m_bGameRunning && m_boardState == EBS_SECOND_SELECTION)
+	for (int i = 0; i < 4; ++i)
 	{
-		SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-		SDL_Rect selectedRect;
+		hash ^= (value >> (8 * i)) & 0xFF;
+		hash *= 16777619u;
+	}
+}
+
+static uint32_t floatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+uint32_t BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::computeChecksum() const
+{
+	uint32_t hash = 2166136261u;
+	for (int row = 0; row < ROWS; ++row)
+	{
+		for (int col = 0; col < COLS; ++col)
+		{
+			hashValue(hash, static_cast<uint32_t>(mat(row, col).color));
+		}
+	}
+
+	for (int i = 0; i < m_swappingGems.size(); ++i)
+	{
+		int gem = Gems::handleSlot(m_swappingGems[i]);
+		hashValue(hash, static_cast<uint32_t>(m_gems.color[gem]));
+		hashValue(hash, floatBits(m_gems.velX[gem] != 0.f ? m_gems.posX[gem] : m_gems.posY[gem]));
+		hashValue(hash, m_gems.destRow[gem] * COLS + m_gems.destCol[gem]);
+		hashValue(hash, /*moving =*/1);
+	}
+
+	//a falling gem hashes the row it would land in if nothing else landed first, which a stacked landing
+	//doesn't store. Only gems that were never predicted are in a dirty column, they still hold their first row
+	for (int col = 0; col < COLS; ++col)
+	{
+		const GemList<kMaxFallingGemsPerCol>& falling = m_fallingGems[col];
+		Mask filled = GemsBitBoard::columnMask(col) & ~m_bits.getEmptyMask();
+		bool bPredicted = !(m_landingsDirtyCols & ColumnSet::bit(col));
+		hashValue(hash, falling.size());
+		for (int i = 0; i < falling.size(); ++i)
+		{
+			int gem = Gems::handleSlot(falling[i]);
+			hashValue(hash, static_cast<uint32_t>(m_gems.color[gem]));
+			hashValue(hash, floatBits(getFallingGemY(gem, m_fallTime_s)));
+			hashValue(hash, bPredicted ? getLandingRow(gem, filled) : m_gems.destRow[gem]);
+		}
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		hashValue(hash, m_random.getState(i));
+	}
+	hashValue(hash, m_score);
+	hashValue(hash, getSecondsLeft());
+	hashValue(hash, m_boardState);
+	hashValue(hash, m_lastClickedRow * COLS + m_lastClickedCol);
+	hashValue(hash, m_bGameRunning);
+	return hash;
+}
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::takeSnapshot(Snapshot& snapshot)
+{
+	snapshot.hasSelection = m_bGameRunning && m_boardState == EBS_SECOND_SELECTION;
+	if (snapshot.hasSelection)
+	{
+		SDL_Rect& selectedRect = snapshot.selectionRect;
 		selectedRect.x = m_boardBoundsXMin + m_lastClickedCol * m_tileSizeW;
 		selectedRect.y = m_boardBoundsYMin + m_lastClickedRow * m_tileSizeH;
 		selectedRect.w = m_tileSizeW;
 		selectedRect.h = m_tileSizeH;
-		SDL_RenderDrawRect(renderer, &selectedRect);
 	}
 
-	auto& gemTextures = m_pAssetMgr->getGemTextures();
-	for (int row = 0; row < kBoardRows; ++row)
+	Move hint;
+	snapshot.hasHint = m_bGameRunning && m_bHintVisible && getHint(hint);
+	if (snapshot.hasHint)
 	{
-		for (int col = 0; col < kBoardCols; ++col)
+		SDL_Rect& hintRect = snapshot.hintRect;
+		hintRect.x = m_boardBoundsXMin + min(hint.col1, hint.col2) * m_tileSizeW;
+		hintRect.y = m_boardBoundsYMin + min(hint.row1, hint.row2) * m_tileSizeH;
+		hintRect.w = (abs(hint.col1 - hint.col2) + 1) * m_tileSizeW;
+		hintRect.h = (abs(hint.row1 - hint.row2) + 1) * m_tileSizeH;
+	}
+
+	for (int row = 0; row < ROWS; ++row)
+	{
+		for (int col = 0; col < COLS; ++col)
 		{
 			Cell& crtCell = mat(row, col);
-			if (isStaticGem(crtCell))
-			{
-				Point pos = getTileCenter(row, col);
-				m_pGfxMgr->renderTexture(gemTextures[crtCell.color], pos.x, pos.y);
-			}
+			snapshot.staticCells[row][col] = isStaticGem(crtCell) ? crtCell.color : Snapshot::kNoStaticGem;
 		}
 	}
 
-	for (SwappingGem& gem : m_swappingGems)
+	int numGems = 0;
+
+	for (int i = 0; i < m_swappingGems.size(); ++i)
 	{
-		if (gem.m_bMoving)
+		int gem = Gems::handleSlot(m_swappingGems[i]);
+		typename Snapshot::Gem& snapGem = snapshot.gems[numGems++];
+		snapGem.x = static_cast<int>(m_gems.posX[gem]);
+		snapGem.y = static_cast<int>(m_gems.posY[gem]);
+		snapGem.prevX = static_cast<int>(m_gems.prevPosX[gem]);
+		snapGem.prevY = static_cast<int>(m_gems.prevPosY[gem]);
+		snapGem.color = m_gems.color[gem];
+	}
+
+	for (int col = 0; col < COLS; ++col)
+	{
+		const GemList<kMaxFallingGemsPerCol>& falling = m_fallingGems[col];
+		for (int i = 0; i < falling.size(); ++i)
 		{
-			m_pGfxMgr->renderTexture(gemTextures[gem.m_color], gem.x(), gem.y());
+			int gem = Gems::handleSlot(falling[i]);
+			typename Snapshot::Gem& snapGem = snapshot.gems[numGems++];
+			snapGem.x = snapGem.prevX = static_cast<int>(m_gems.posX[gem]);
+			snapGem.y = static_cast<int>(getFallingGemY(gem, m_fallTime_s));
+			snapGem.prevY = static_cast<int>(getFallingGemY(gem, m_prevFallTime_s));
+			snapGem.color = m_gems.color[gem];
 		}
 	}
+	assert(numGems <= Snapshot::kMaxGems);
+	snapshot.numGems = numGems;
 
+	snapshot.score = m_score;
+	snapshot.secondsLeft = getSecondsLeft();
+	snapshot.animating = m_bGameRunning || !isSettled();
+}
 
-	for (size_t fallCol = 0; fallCol < kBoardCols; ++fallCol)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::render(SDL_Renderer* renderer, const Snapshot& snapshot, float alpha) const
+{
+	assert(m_pAssetMgr && m_pGfxMgr && "A headless board can't be rendered");
+	if (snapshot.hasSelection)
 	{
-		int endIdx = m_fallingGemsEndIdx[fallCol];
-		if (endIdx < m_fallingGemsStartIdx[fallCol])
-		{
-			endIdx += kBoardRowsPlusOne;
-		}
+		SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+		SDL_RenderDrawRect(renderer, &snapshot.selectionRect);
+	}
 
-		for (int i = m_fallingGemsStartIdx[fallCol], n = endIdx; i < n; ++i)
-		{
-			int idx = i % kBoardRowsPlusOne;
-			FallingGem& gem = m_fallingGems[fallCol][idx];
-			m_pGfxMgr->renderTexture(gemTextures[gem.m_color], gem.x(), gem.y());
-		}
+	if (snapshot.hasHint)
+	{
+		SDL_SetRenderDrawColor(renderer, 0, 255, 255, 255);
+		SDL_RenderDrawRect(renderer, &snapshot.hintRect);
 	}
-	//for (auto& gems : m_fallingGems)
-	//{
-	//	for (FallingGem& gem : gems)
-	//	{
-	//		if (gem.m_bMoving)
-	//		{
-	//			m_pGfxMgr->renderTexture(gemTextures[gem.m_color], gem.x(), gem.y());
-	//		}
-	//	}
-	//}
+
+	//the static gems are drawn by GraphicsMgr, these are the moving ones
+	//every gem comes from the same atlas, so they all go out together
+	SpriteBatch& gemBatch = m_pGfxMgr->getGemBatch();
+	gemBatch.begin(m_pAssetMgr->getGemAtlasTex());
+	for (int i = 0; i < snapshot.numGems; ++i)
+	{
+		const typename Snapshot::Gem& gem = snapshot.gems[i];
+		int x = gem.prevX + static_cast<int>((gem.x - gem.prevX) * alpha);
+		int y = gem.prevY + static_cast<int>((gem.y - gem.prevY) * alpha);
+		gemBatch.add(m_pAssetMgr->getGemRect(gem.color), x, y);
+	}
+	gemBatch.flush(renderer);
 
 	DrawGrid(renderer);
 }
 
-void Board::DrawGrid(SDL_Renderer* renderer)
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::DrawGrid(SDL_Renderer* renderer) const
 {
 	if (m_pGfxMgr->getDebugDraw())
 	{
 		SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-		for (int row = 0; row <= kBoardRows; ++row)
+		for (int row = 0; row <= ROWS; ++row)
 		{
 			int lineY = m_boardBoundsYMin + row * m_tileSizeH;
 			SDL_RenderDrawLine(renderer, m_boardBoundsXMin, lineY, m_boardBoundsXMax, lineY);
 		}
 
-		for (int col = 0; col <= kBoardCols; ++col)
+		for (int col = 0; col <= COLS; ++col)
 		{
 			int lineX = m_boardBoundsXMin + col * m_tileSizeW;
 			SDL_RenderDrawLine(renderer, lineX, m_boardBoundsYMin, lineX, m_boardBoundsYMax);
@@ -715,60 +1195,48 @@ void Board::DrawGrid(SDL_Renderer* renderer)
 	}
 }
 
-int Board::getTileCenterX(int col) const 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getTileCenterX(int col) const 
 { 
 	return m_boardBoundsXMin + m_paddingW / 2 + col * m_tileSizeW;
 }
-int Board::getTileCenterY(int row) const 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getTileCenterY(int row) const 
 {
 	return m_boardBoundsYMin + m_paddingH / 2 + row * m_tileSizeH;
 }
-Point Board::getTileCenter(int row, int col) const 
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+Point BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getTileCenter(int row, int col) const 
 {
 	return Point(getTileCenterX(col), getTileCenterY(row));
 }
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+void BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getTileRect(int row, int col, SDL_Rect& rect) const
+{
+	rect.x = m_boardBoundsXMin + col * m_tileSizeW;
+	rect.y = m_boardBoundsYMin + row * m_tileSizeH;
+	rect.w = m_tileSizeW;
+	rect.h = m_tileSizeH;
+}
 
-int Board::getRowByPos(int y) const
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getRowByPos(int y) const
 {
 	return (y - m_boardBoundsYMin - m_paddingH / 2) / m_tileSizeH;
 }
-int Board::getColByPos(int x) const
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+int BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getColByPos(int x) const
 {
 	return (x - m_boardBoundsXMin - m_paddingW / 2) / m_tileSizeW;
 }
 
-Utils::Point Board::getCellByPos(int x, int y) const
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+Utils::Point BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::getCellByPos(int x, int y) const
 {
 	return Point(getRowByPos(y), getColByPos(x));
 }
 
-Board::SwappingGem::SwappingGem(int startX, int startY, int destX, int destY, int swapPairIdx, int dest_row, int dest_col, int8_t color)
-{
-	assert(color != kEmptyCellColor && color != kSwapCellColor);
-	m_swapPairIdx = swapPairIdx;
-
-	m_destRow = dest_row;
-	m_destCol = dest_col;
-
-	m_bMoving = true;
-	m_bAxisX = (startY == destY);
-	assert((startX == destX) != m_bAxisX);
-
-	m_bPositiveDir = ((destX - startX) + (destY - startY)) > 0;
-
-	m_speed = 4.f * kPixelsPerMeters;
-
-	if (m_bAxisX)
-	{
-		m_pos = static_cast<float>(startX);
-		m_finalPos = destX;
-		m_otherAxisPos = startY;
-	}
-	else
-	{
-		m_pos = static_cast<float>(startY);
-		m_finalPos = destY;
-		m_otherAxisPos = startX;
-	}
-	m_color = color;
-}
\ No newline at end of file
+// the game board, and the larger ones the stress runs simulate
+template class BasicBoard<kBoardRows, kBoardCols, kBoardMaxGemTypes>;
+template class BasicBoard<16, 16, kBoardMaxGemTypes>;
+template class BasicBoard<64, 64, kBoardMaxGemTypes>;
@@ -1,11 +1,19 @@
 #ifndef BOARD_H
 #define BOARD_H
+#include "BoardFwd.h"
 #include "Matrix.h"
+#include "BitBoard.h"
+#include "RunKernel.h"
+#include "MoveIndex.h"
+#include "Random.h"
+#include "GemTable.h"
+#include "EventQueue.h"
 #include <SDL_config.h>
 #include <vector>
 #include <assert.h>
 
 struct SDL_Renderer;
+struct SDL_Rect;
 class AssetMgr;
 class GraphicsMgr;
 namespace Utils
@@ -13,15 +21,30 @@ namespace Utils
 	struct Point;
 };
 
-static const int kBoardRows = 8;
-static const int kBoardCols = 8;
 static const int kBoardRowsPlusOne = kBoardRows + 1;
 static const int kPixelsPerMeters = 45;
 static const int kTotalTime_s = 60;
 
-static_assert(kBoardRows > 1 && kBoardCols > 1, "Invalid number of rows or columns.");
-class Board
+// Default board layout inside the game window, shared by the windowed game and the headless driver
+static const int kDefaultGemW = 35;
+static const int kDefaultGemH = 35;
+static const int kDefaultBoardBoundsXMin = 315;
+static const int kDefaultBoardBoundsYMin = 95;
+static const int kDefaultBoardW = 360;
+static const int kDefaultBoardH = 352;
+
+// The rules of the game on a board of ROWS x COLS cells holding up to MAX_GEM_TYPES gem types.
+// The game plays on Board, the larger instantiations are only simulated headless
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+class BasicBoard
 {
+	static_assert(ROWS > 1 && COLS > 1, "Invalid number of rows or columns.");
+	// rows and columns are stored on int8_t in the gem table
+	static_assert(ROWS < 128 && COLS < 128, "Too many rows or columns.");
+
+	// reaches into the private hot paths to time them one by one
+	friend class BoardBenchmark;
+
 private:
 	static const int8_t kEmptyCellColor	= -1;
 	static const int8_t kSwapCellColor	= -2;
@@ -30,111 +53,66 @@ private:
 	{
 		int8_t color;
 	};
-	typedef Matrix<Cell, kBoardRows, kBoardCols> GemsMatrix;
-	
-	class SwappingGemsPair
-	{
-
-		bool m_bReturning;
-		int m_pairState;
-		int m_gem1Idx;
-		int m_gem2Idx;
-	
-	public:
-		static const int kNotFinished = 0;
-		static const int kOtherGemChained = 1;
-		static const int kOtherGemDidntChain = 2;
-
-		SwappingGemsPair(int gem1Idx, int gem2Idx) : 
-			m_pairState(kNotFinished), 
-			m_gem1Idx(gem1Idx), 
-			m_gem2Idx(gem2Idx),
-			m_bReturning(false)
-		{
-		}
-		void setGem1Idx(int idx) { m_gem1Idx = idx; }
-		void setGem2Idx(int idx) { m_gem2Idx = idx; }
-		int getGem1Idx() const { return m_gem1Idx; }
-		int getGem2Idx() const { return m_gem2Idx; }
-
-		void setIsReturning() { m_bReturning = true; }
-		bool isReturning() const { return m_bReturning; }
-
-		void setHasChained(bool hasChained)
-		{
-			m_pairState = hasChained ? kOtherGemChained : kOtherGemDidntChain;
-		}
-
-		bool hasFinished() const { return m_pairState != kNotFinished;	}
-		bool hasChained() const { return m_pairState == kOtherGemChained; }
-	};
-	std::vector<SwappingGemsPair> m_swappingGemPairs;
-
-	//@TODO: SwappingGem and FallingGem could use a little more encapsulation
+	static_assert(sizeof(Cell) == 1, "GemsRunKernel reads the cells as their colors.");
+	typedef Matrix<Cell, ROWS, COLS> GemsMatrix;
+	typedef BitBoard<ROWS, COLS, MAX_GEM_TYPES> GemsBitBoard;
+	// scans the colors of mat directly, a cell per byte
+	typedef RunKernel<ROWS, COLS> GemsRunKernel;
+	typedef typename GemsBitBoard::Mask Mask;
+	typedef MoveIndex<ROWS, COLS, MAX_GEM_TYPES> GemsMoveIndex;
+	// one bit per column
+	typedef MaskOf<COLS> ColumnSet;
+	typedef BasicBoardLayout<ROWS, COLS, MAX_GEM_TYPES> Layout;
 	
-	struct SwappingGem
-	{
-		bool m_bMoving;
-
-		bool	m_bAxisX;
-		bool	m_bPositiveDir;
-		float	m_speed;
-		float	m_pos;
-		int		m_otherAxisPos;
-
-		int		m_finalPos;
-		int		m_destRow;
-		int		m_destCol;
-		int		m_swapPairIdx;
-
-		int8_t m_color;
-
-		void invalidatePair() { m_swapPairIdx = -1; }
-		bool hasValidPair() const { return m_swapPairIdx >= 0; }
-
-		int x() const { return m_bAxisX ? static_cast<int>(m_pos) : m_otherAxisPos; }
-		int y() const { return m_bAxisX ? m_otherAxisPos : static_cast<int>(m_pos); }
-
-		SwappingGem(int startX, int startY, int destX, int destY, int swapPairIdx, int dest_row, int dest_col, int8_t color);
-	};
+public:
+	static const int kRows = ROWS;
+	static const int kCols = COLS;
 
-	struct FallingGem
-	{
-		//bool m_bMoving;
-		float m_speed;
-		float m_posX;
-		float m_posY;
-		int8_t m_color;
-
-		int x() const { return static_cast<int>(m_posX); }
-		int y() const { return static_cast<int>(m_posY); }
-
-		void init(int startX, int startY, int8_t color)
-		{
-			//m_bMoving = true;
-			m_speed = 4.f * kPixelsPerMeters;
-			m_posX = static_cast<float>(startX);
-			m_posY = static_cast<float>(startY);
-			m_color = color;
-		}
-	};
-	
+	// every cell can be the destination of a swapping gem, plus the swap back it starts when it arrives before
+	// being released. A column never has more gems falling in than twice its height
+	static const int kMaxSwappingGems = 2 * ROWS * COLS;
+	static const int kMaxFallingGemsPerCol = 2 * ROWS;
+	static const int kMaxMovingGems = kMaxSwappingGems + COLS * kMaxFallingGemsPerCol;
 
+	typedef BasicBoardSnapshot<ROWS, COLS, MAX_GEM_TYPES> Snapshot;
+	typedef BasicBoardPool<ROWS, COLS, MAX_GEM_TYPES> Pool;
 
-	std::vector<SwappingGem>	m_swappingGems;
-	
-	// m_fallingGems is a vector of kBoardCols ring buffers used to make sure we update the 
-	// gems in order, without reallocating memory and without sorting them each frame
-	std::vector<std::vector<FallingGem> >	m_fallingGems;
-	std::vector<int> m_fallingGemsStartIdx;
-	std::vector<int> m_fallingGemsEndIdx;
+private:
+	typedef GemTable<kMaxMovingGems> Gems;
+	Gems m_gems;
+
+	// swapping gems in the order they are updated
+	GemList<kMaxSwappingGems> m_swappingGems;
+	// the gems falling in each column, oldest first
+	GemList<kMaxFallingGemsPerCol> m_fallingGems[COLS];
+
+	// Falling gems don't move step by step: each one has the time it will land in its predicted cell, by slot.
+	// The prediction of a column is redone whenever one of its cells gets emptied or filled, except by the landings
+	// of gems that were predicted to land on each other
+	EventQueue<kMaxMovingGems> m_landings;
+	double m_fallTime_s;		// the clock of the falls, only the differences matter
+	double m_prevFallTime_s;	// at the previous update
+	typename ColumnSet::Type m_landingsDirtyCols;	// the columns whose landings have to be predicted again
+	typename ColumnSet::Type m_stackedLandingCols;	// the columns whose gems were predicted to land on each other
+
+	// cells emptied since their column was last refilled. A column is refilled once it has no gem falling in,
+	// so only the columns something happened to are looked at
+	Mask m_emptiedCells;
 
 	enum EBoardState {EBS_FIRST_SELECTION, EBS_SECOND_SELECTION};
 	EBoardState m_boardState;
 	
 	GemsMatrix mat;
+	// mirrors mat one bit per cell and color, it must only be modified through setCellColor
+	GemsBitBoard m_bits;
+	// swaps that would make a match, refreshed lazily around the cells changed by setCellColor
+	GemsMoveIndex m_moveIndex;
+	bool m_bHintVisible;
 
 	int m_numGemTypes;
+	Random m_random;
+	Pool* m_pBoardPool;	// optional, where new games take their board from when it has it ready
+	int8_t randomGemColor() { return static_cast<int8_t>(m_random.nextInt(m_numGemTypes)); }
 
 	int m_gemW;
 	int m_gemH;
@@ -157,15 +135,16 @@ private:
 	int8_t	m_lastClickedColor;
 	
 	int m_score;
-	uint32_t m_time_ms;
+	double m_time_ms;	// not rounded per update, so the game clock doesn't drift with the frame rate
 		
 	bool m_bGameRunning;
 
 	bool solveBoardAtPos(int modifiedCellRow, int modifiedCellCol);
 	void solveFallAtPos(int row, int col);
 
-	void DrawGrid(SDL_Renderer* renderer);
+	void DrawGrid(SDL_Renderer* renderer) const;
 	
+	// Both managers are optional: a headless board (nullptr managers) plays no sounds and must not be rendered
 	AssetMgr* m_pAssetMgr;
 	GraphicsMgr* m_pGfxMgr;
 
@@ -173,25 +152,73 @@ private:
 	//void	setAssetMgr(AssetMgr* assetMgr) { m_pAssetMgr = assetMgr; }
 	//void	setGraphicsMgr(GraphicsMgr* gfxMgr) { m_pAssetMgr = assetMgr; }
 
+	void setCellColor(int row, int col, int8_t color);
 	bool isCellEmpty(int row, int col) const { return mat(row, col).color == kEmptyCellColor; }
 	bool isCellSwapping(int row, int col) const { return mat(row, col).color == kSwapCellColor; }
+	// the colors of mat row after row, one byte per cell
+	const int8_t* getCellColors() const { return &mat.data()->color; }
 	bool isStaticGem(const Cell& crtCell) const { return crtCell.color != kEmptyCellColor && crtCell.color != kSwapCellColor; }
 
 	int checkLineChain(int startRow, int startCol, bool axisX, bool positiveDir) const;
 
 	void swapGems(int row1, int col1, int row2, int col2, bool addPair);
-	void releasePair(int swapPairIdx);
-	void removeSwappingGem(int idx);
+	void addSwappingGem(int startRow, int startCol, int destRow, int destCol);
+	void releaseSwappingGem(int listIdx);
 	void updateSwappingGems(float dt_s);
 	void updateFallingGems(float dt_s);
 
-	void addFallingGem(int startX, int startY, int8_t color);
+	void dropNewGems(const Layout& layout);
+	void reshuffle();
+	bool isSettled() const;
+
+	void addFallingGem(int col, int startY, int8_t color);
+	float getFallingGemY(int gem, double time_s) const;
+	int getFallingGemRow(int gem, double time_s) const;
+	int getLandingRow(int gem, Mask filled) const;
+	double getLandingTime(int gem, int landRow) const;
+	void predictLandings(int col);
+	void predictDirtyLandings();
+	void landFallingGem(int gem);
+	void refillEmptiedColumns();
+	int countFallingGemsBelow(int col, int y) const;
 	bool solveSelectionValidity();
 
 public:
+	struct Move
+	{
+		int row1;
+		int col1;
+		int row2;
+		int col2;
+		Move() : row1(-1), col1(-1), row2(-1), col2(-1) {}
+		Move(int row1, int col1, int row2, int col2) : row1(row1), col1(col1), row2(row2), col2(col2) {}
+	};
+
+	// all the swaps of two neighbouring static gems that would make a match
+	void getValidMoves(std::vector<Move>& moves);
+	bool hasValidMove();
+	bool getHint(Move& move);
+	void setHintVisible(bool visible) { m_bHintVisible = visible; }
+
+	// Summary of one resolveCascadeStep call
+	struct CascadeStep
+	{
+		Mask clearedMask;
+		int numCleared;
+		int score;
+		int numFallingGems;	// static gems that started falling into the cleared cells
+		int numRefills;		// new gems spawned above the board
+		int columnHoles[COLS];	// cells cleared per column, i.e. how far the gems above them fall
+	};
+
+	// Finds every run of 3+ touching regionMask in one pass over the board, clears them, makes the gems
+	// above the cleared cells fall and spawns the refills, all in one batch
+	CascadeStep resolveCascadeStep(Mask regionMask = GemsBitBoard::kAllCells);
+
 	int getTileCenterX(int col) const;
 	int getTileCenterY(int row) const;
 	Utils::Point getTileCenter(int row, int col) const;
+	void getTileRect(int row, int col, SDL_Rect& rect) const;
 	
 	int getRowByPos(int y) const;
 	int getColByPos(int x) const;
@@ -199,10 +226,14 @@ public:
 
 
 	void update(float dt_ms);
-	void render(SDL_Renderer* renderer);
-	void Board::mouseEvent(int x, int y, bool bMouseDown);
-	Board(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int boardBoundsYMin, int boardW, int boardH, AssetMgr* pAssetMgr, GraphicsMgr* pGfxMgr);
-	~Board();
+	// copies what render needs, so that the board can be drawn on another thread while it keeps updating
+	void takeSnapshot(Snapshot& snapshot);
+	// only reads the board layout, which never changes after construction.
+	// alpha in [0, 1] is how far the time being rendered is between the last two updates
+	void render(SDL_Renderer* renderer, const Snapshot& snapshot, float alpha) const;
+	void mouseEvent(int x, int y, bool bMouseDown);
+	BasicBoard(int numGemTypes, int gemW, int gemH, int boardBoundsXMin, int boardBoundsYMin, int boardW, int boardH, AssetMgr* pAssetMgr, GraphicsMgr* pGfxMgr);
+	~BasicBoard();
 	int getScore() const { return m_score; }
 	int getSecondsLeft() const
 	{
@@ -210,6 +241,20 @@ public:
 		return m_time_s > 0 ? m_time_s : 0; 
 	}
 	void init();
+	void init(uint64_t seed);
+	// must be set before the game runs on another thread, init(seed) then copies the board of seed from the pool
+	// when it is ready instead of generating it
+	void setBoardPool(Pool* pool) { m_pBoardPool = pool; }
+
+	// the generator every new gem color is drawn from, reseeding it makes the rest of the game reproducible
+	Random&		getRandom()				{ return m_random; }
+	uint64_t	getSeed() const			{ return m_random.getSeed(); }
+	int			getNumGemTypes() const	{ return m_numGemTypes; }
+	// hash of everything that decides how the game goes on, two boards with the same checksum 
+	// play the same from there on given the same input
+	uint32_t	computeChecksum() const;
+	void		setSeed(uint64_t seed)	{ m_random.setSeed(seed); }
 	void setGameRunning(bool running) { m_bGameRunning = running; }
+	bool isGameRunning() const { return m_bGameRunning; }
 };
 #endif//BOARD_H
@@ -0,0 +1,371 @@
+#include "BoardBenchmark.h"
+#include "Board.h"
+#include "BoardPool.h"
+#include "AllocCounter.h"
+#include "Common.h"
+
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+typedef chrono::high_resolution_clock BenchClock;
+
+static const float kSettleFrameTime_ms = 1000.f / 60.f;
+static const int kMaxSettleFrames = 10000;
+static const int kSwapsInFlight = 4;
+
+static double secondsSince(BenchClock::time_point start)
+{
+	return chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+BoardBenchmark::BoardBenchmark(int numGemTypes, uint64_t seed, long long numOps) :
+	m_numGemTypes(numGemTypes),
+	m_seed(seed),
+	m_numOps(numOps),
+	m_checksum(0)
+{
+	assert(numOps > 0);
+	for (int i = 0; i < kNumFixtures; ++i)
+	{
+		Board* dropping = createBoard();
+		dropping->init(seed + i);
+		m_droppingFixtures.push_back(unique_ptr<Board>(dropping));
+
+		Board* settled = createBoard();
+		settled->init(seed + i);
+		settle(*settled);
+		m_settledFixtures.push_back(unique_ptr<Board>(settled));
+	}
+	m_pWorkBoard.reset(createBoard());
+}
+
+BoardBenchmark::~BoardBenchmark()
+{
+}
+
+Board* BoardBenchmark::createBoard() const
+{
+	return new Board(	m_numGemTypes,
+						kDefaultGemW,
+						kDefaultGemH,
+						kDefaultBoardBoundsXMin,
+						kDefaultBoardBoundsYMin,
+						kDefaultBoardW,
+						kDefaultBoardH,
+						/*pAssetMgr =*/nullptr,
+						/*pGfxMgr =*/nullptr);
+}
+
+void BoardBenchmark::settle(Board& board) const
+{
+	for (int frame = 0; frame < kMaxSettleFrames && !board.isSettled(); ++frame)
+	{
+		board.update(kSettleFrameTime_ms);
+	}
+	assert(board.isSettled());
+}
+
+void BoardBenchmark::addResult(const char* name, long long numOps, double elapsed_s, uint64_t numAllocs, 
+								double restore_s, uint64_t restoreAllocs)
+{
+	Result result;
+	result.name = name;
+	result.numOps = numOps;
+	result.ns_per_op = max(elapsed_s - restore_s, 0.0) * 1e9 / numOps;
+	result.allocs_per_op = static_cast<double>(numAllocs - min(numAllocs, restoreAllocs)) / numOps;
+	m_results.push_back(result);
+}
+
+void BoardBenchmark::measureRestore(const vector<unique_ptr<Board> >& fixtures, long long numOps, 
+									double& elapsed_s, uint64_t& numAllocs)
+{
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < numOps; ++op)
+	{
+		*m_pWorkBoard = *fixtures[op % kNumFixtures];
+		m_checksum += m_pWorkBoard->mat(0, 0).color;
+	}
+	elapsed_s = secondsSince(start);
+	numAllocs = AllocCounter::getNumAllocations() - startAllocs;
+}
+
+void BoardBenchmark::benchCheckLineChain()
+{
+	//read only, every cell in the four directions
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	long long numOps = 0;
+	for (int fixture = 0; numOps < m_numOps; fixture = (fixture + 1) % kNumFixtures)
+	{
+		const Board& board = *m_settledFixtures[fixture];
+		for (int row = 0; row < kBoardRows; ++row)
+		{
+			for (int col = 0; col < kBoardCols; ++col)
+			{
+				m_checksum += board.checkLineChain(row, col, true, true);
+				m_checksum += board.checkLineChain(row, col, true, false);
+				m_checksum += board.checkLineChain(row, col, false, true);
+				m_checksum += board.checkLineChain(row, col, false, false);
+			}
+		}
+		numOps += 4 * kBoardRows * kBoardCols;
+	}
+	addResult("checkLineChain", numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+}
+
+void BoardBenchmark::benchSolveBoardAtPos()
+{
+	//play the hint of every fixture by hand and solve both swapped cells
+	vector<Board::Move> moves(kNumFixtures);
+	for (int i = 0; i < kNumFixtures; ++i)
+	{
+		bool hasMove = m_settledFixtures[i]->getHint(moves[i]);
+		assert(hasMove && "A settled board always has a valid move");
+	}
+
+	double restore_s;
+	uint64_t restoreAllocs;
+	measureRestore(m_settledFixtures, m_numOps, restore_s, restoreAllocs);
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		int fixture = op % kNumFixtures;
+		Board& board = *m_pWorkBoard;
+		board = *m_settledFixtures[fixture];
+
+		const Board::Move& move = moves[fixture];
+		int8_t color1 = board.mat(move.row1, move.col1).color;
+		int8_t color2 = board.mat(move.row2, move.col2).color;
+		board.setCellColor(move.row1, move.col1, color2);
+		board.setCellColor(move.row2, move.col2, color1);
+
+		m_checksum += board.solveBoardAtPos(move.row1, move.col1);
+		if (board.isStaticGem(board.mat(move.row2, move.col2)))
+		{
+			m_checksum += board.solveBoardAtPos(move.row2, move.col2);
+		}
+	}
+	addResult("solveBoardAtPos", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 
+				restore_s, restoreAllocs);
+}
+
+void BoardBenchmark::benchSolveFallAtPos()
+{
+	//empty a cell in the middle of a column and make everything above it fall
+	static const int kClearedRow = kBoardRows / 2;
+
+	double restore_s;
+	uint64_t restoreAllocs;
+	measureRestore(m_settledFixtures, m_numOps, restore_s, restoreAllocs);
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		Board& board = *m_pWorkBoard;
+		board = *m_settledFixtures[op % kNumFixtures];
+
+		int col = op % kBoardCols;
+		board.setCellColor(kClearedRow, col, Board::kEmptyCellColor);
+		board.solveFallAtPos(kClearedRow - 1, col);
+		m_checksum += board.m_fallingGems[col].size();
+	}
+	addResult("solveFallAtPos", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 
+				restore_s, restoreAllocs);
+}
+
+void BoardBenchmark::benchResolveCascadeStep()
+{
+	//a full-board scan of a settled board, which like most scans finds no run and leaves the board as it is
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		Board& board = *m_settledFixtures[op % kNumFixtures];
+		Board::CascadeStep step = board.resolveCascadeStep();
+		assert(step.numCleared == 0);
+		m_checksum += step.numCleared + step.columnHoles[op % kBoardCols];
+	}
+	addResult("resolveCascadeStep", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+}
+
+void BoardBenchmark::benchUpdateFallingGems()
+{
+	//the first frame of the whole board falling in, predicts where and when every gem lands
+	static const float kFrameTime_s = kSettleFrameTime_ms * 0.001f;
+
+	double restore_s;
+	uint64_t restoreAllocs;
+	measureRestore(m_droppingFixtures, m_numOps, restore_s, restoreAllocs);
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		Board& board = *m_pWorkBoard;
+		board = *m_droppingFixtures[op % kNumFixtures];
+
+		board.updateFallingGems(kFrameTime_s);
+		m_checksum += board.m_fallingGems[op % kBoardCols].size();
+	}
+	addResult("updateFallingGems", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 
+				restore_s, restoreAllocs);
+}
+
+void BoardBenchmark::benchSettle()
+{
+	//a whole new board falling in until every gem has landed, frame by frame
+	double restore_s;
+	uint64_t restoreAllocs;
+	long long numOps = max(m_numOps / 100, 1LL);
+	measureRestore(m_droppingFixtures, numOps, restore_s, restoreAllocs);
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < numOps; ++op)
+	{
+		Board& board = *m_pWorkBoard;
+		board = *m_droppingFixtures[op % kNumFixtures];
+
+		settle(board);
+		m_checksum += board.mat(0, op % kBoardCols).color;
+	}
+	addResult("settle", numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 
+				restore_s, restoreAllocs);
+}
+
+void BoardBenchmark::benchIdleUpdate()
+{
+	//a frame where nothing happens, the board stays settled so it isn't restored
+	Board& board = *m_pWorkBoard;
+	board = *m_settledFixtures[0];
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		board.update(kSettleFrameTime_ms);
+		m_checksum += board.m_fallingGems[op % kBoardCols].size();
+	}
+	addResult("idle update", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+}
+
+void BoardBenchmark::benchSwapChurn()
+{
+	//a few swaps in flight released in the order they were started, which exercises the
+	//handle allocation and the partner bookkeeping. The board is put back by hand
+	Board& board = *m_pWorkBoard;
+	board = *m_settledFixtures[0];
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	long long numOps = 0;
+	while (numOps < m_numOps)
+	{
+		int8_t colors[kSwapsInFlight][2];
+		for (int i = 0; i < kSwapsInFlight; ++i)
+		{
+			int row = i * 2;
+			colors[i][0] = board.mat(row, 0).color;
+			colors[i][1] = board.mat(row, 1).color;
+			board.swapGems(row, 0, row, 1, true);
+		}
+		for (int i = 0; i < kSwapsInFlight; ++i)
+		{
+			m_checksum += board.m_swappingGems[0];
+			board.releaseSwappingGem(0);
+			board.releaseSwappingGem(0);
+		}
+		for (int i = 0; i < kSwapsInFlight; ++i)
+		{
+			int row = i * 2;
+			board.setCellColor(row, 0, colors[i][0]);
+			board.setCellColor(row, 1, colors[i][1]);
+		}
+		numOps += kSwapsInFlight;
+	}
+	addResult("swap/release churn", numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+}
+
+void BoardBenchmark::benchInit()
+{
+	//the generation of a new board and the reset of all the gem containers
+	Board& board = *m_pWorkBoard;
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	BenchClock::time_point start = BenchClock::now();
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		board.init(m_seed + op);
+		m_checksum += board.m_gems.color[Board::Gems::handleSlot(board.m_fallingGems[0][0])];
+	}
+	addResult("init", m_numOps, secondsSince(start), AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+}
+
+void BoardBenchmark::benchInitFromPool()
+{
+	//a restart of the game, whose board the pool generated in the background. Restarts are far apart
+	//in a real game, so each one waits for a ready board before being timed
+	Board& board = *m_pWorkBoard;
+	BoardPool pool(m_numGemTypes, m_seed);
+	board.setBoardPool(&pool);
+
+	uint64_t startAllocs = AllocCounter::getNumAllocations();
+	double elapsed_s = 0.0;
+	for (long long op = 0; op < m_numOps; ++op)
+	{
+		while (pool.getNumReady() == 0)
+		{
+			this_thread::yield();
+		}
+
+		uint64_t seed = pool.claimSeed();
+
+		BenchClock::time_point start = BenchClock::now();
+		board.init(seed);
+		elapsed_s += secondsSince(start);
+		m_checksum += board.m_gems.color[Board::Gems::handleSlot(board.m_fallingGems[0][0])];
+	}
+	addResult("init from pool", m_numOps, elapsed_s, AllocCounter::getNumAllocations() - startAllocs, 0.0, 0);
+	board.setBoardPool(nullptr);
+}
+
+void BoardBenchmark::run()
+{
+	m_results.clear();
+	benchCheckLineChain();
+	benchSolveBoardAtPos();
+	benchSolveFallAtPos();
+	benchResolveCascadeStep();
+	benchUpdateFallingGems();
+	benchSettle();
+	benchIdleUpdate();
+	benchSwapChurn();
+	benchInit();
+	benchInitFromPool();
+}
+
+void BoardBenchmark::printResults() const
+{
+	cout << "bench: seed " << m_seed << ", " << m_numGemTypes << " gem types" << endl;
+	for (const Result& result : m_results)
+	{
+		cout << "bench: " << left << setw(20) << result.name << right 
+			<< setw(12) << result.numOps << " ops "
+			<< fixed << setprecision(2) << setw(10) << result.ns_per_op << " ns/op "
+			<< setw(8) << result.allocs_per_op << " allocs/op" << endl;
+		cout.unsetf(ios::fixed);
+	}
+	if (!AllocCounter::isEnabled())
+	{
+		cout << "bench: allocations are not counted, build with ALLOC_COUNTER defined" << endl;
+	}
+	cout << "bench: checksum " << m_checksum << endl;
+}
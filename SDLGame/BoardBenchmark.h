@@ -0,0 +1,67 @@
+#ifndef BOARD_BENCHMARK_H
+#define BOARD_BENCHMARK_H
+
+#include "BoardFwd.h"
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+// Micro-benchmarks of the Board hot paths, run over boards built from fixed seeds so that two runs
+// measure exactly the same work. Each one reports ns/op and heap allocations/op.
+// Operations that modify the board restore it from its fixture first; the cost of the restore alone
+// is measured separately and subtracted.
+class BoardBenchmark
+{
+public:
+	static const int kNumFixtures = 32;
+
+	struct Result
+	{
+		const char* name;
+		long long numOps;
+		double ns_per_op;
+		double allocs_per_op;
+	};
+
+private:
+	int m_numGemTypes;
+	uint64_t m_seed;
+	long long m_numOps;
+
+	std::vector<std::unique_ptr<Board> > m_settledFixtures;	// boards with no gem moving
+	std::vector<std::unique_ptr<Board> > m_droppingFixtures;	// boards just after init(), every gem falling
+	std::unique_ptr<Board> m_pWorkBoard;
+
+	std::vector<Result> m_results;
+	uint64_t m_checksum;	// consumes the results so the compiler can't drop the work
+
+	Board* createBoard() const;
+	void settle(Board& board) const;
+	void addResult(const char* name, long long numOps, double elapsed_s, uint64_t numAllocs, 
+					double restore_s, uint64_t restoreAllocs);
+
+	void benchCheckLineChain();
+	void benchSolveBoardAtPos();
+	void benchSolveFallAtPos();
+	void benchResolveCascadeStep();
+	void benchUpdateFallingGems();
+	void benchSettle();
+	void benchIdleUpdate();
+	void benchSwapChurn();
+	void benchInit();
+	void benchInitFromPool();
+
+	// time and allocations spent copying the fixtures over the work board, to subtract from the others
+	void measureRestore(const std::vector<std::unique_ptr<Board> >& fixtures, long long numOps, 
+						double& elapsed_s, uint64_t& numAllocs);
+
+public:
+	BoardBenchmark(int numGemTypes, uint64_t seed, long long numOps);
+	~BoardBenchmark();
+
+	void run();
+	void printResults() const;
+	const std::vector<Result>& getResults() const { return m_results; }
+};
+#endif//BOARD_BENCHMARK_H
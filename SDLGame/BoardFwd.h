@@ -0,0 +1,34 @@
+#ifndef BOARD_FWD_H
+#define BOARD_FWD_H
+
+#include <assert.h>
+
+// The size of the game board, and the names of the board types for the headers that only refer to them.
+// Everything sized by the board is a template over its rows, columns and maximum number of gem types,
+// so the game board is compiled for its exact size and larger ones can be instantiated for stress runs
+static const int kBoardRows = 8;
+static const int kBoardCols = 8;
+static const int kBoardMaxGemTypes = 8;
+
+template <int ROWS, int COLS, int MAX_GEM_TYPES> class BasicBoard;
+template <int ROWS, int COLS, int MAX_GEM_TYPES> struct BasicBoardLayout;
+template <int ROWS, int COLS, int MAX_GEM_TYPES> class BasicBoardPool;
+template <int ROWS, int COLS, int MAX_GEM_TYPES> struct BasicBoardSnapshot;
+
+typedef BasicBoard<kBoardRows, kBoardCols, kBoardMaxGemTypes>			Board;
+typedef BasicBoardLayout<kBoardRows, kBoardCols, kBoardMaxGemTypes>		BoardLayout;
+typedef BasicBoardPool<kBoardRows, kBoardCols, kBoardMaxGemTypes>		BoardPool;
+typedef BasicBoardSnapshot<kBoardRows, kBoardCols, kBoardMaxGemTypes>	BoardSnapshot;
+
+// only ever simulated headless, see StressDriver
+typedef BasicBoard<16, 16, kBoardMaxGemTypes>	LargeBoard;
+typedef BasicBoard<64, 64, kBoardMaxGemTypes>	HugeBoard;
+
+// Checks a fast board path against the slower one it replaced. The project keeps its asserts in Release,
+// so these only run in the builds that define BOARD_CROSS_CHECKS (the Debug configuration)
+#ifdef BOARD_CROSS_CHECKS
+#define BOARD_CROSS_CHECK(expr) assert(expr)
+#else
+#define BOARD_CROSS_CHECK(expr)
+#endif
+#endif//BOARD_FWD_H
@@ -0,0 +1,95 @@
+#ifndef BOARD_GENERATOR_H
+#define BOARD_GENERATOR_H
+
+#include "BoardFwd.h"
+#include "BitBoard.h"
+#include "MoveIndex.h"
+#include "RunKernel.h"
+#include "Random.h"
+
+#include <algorithm>
+
+#include <assert.h>
+
+// The gems of a new board: no run of 3 anywhere, and at least one swap that makes one
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+struct BasicBoardLayout
+{
+	typedef BitBoard<ROWS, COLS, MAX_GEM_TYPES> Bits;
+
+	int8_t				cells[ROWS][COLS];
+	typename Bits::Mask	gemMasks[MAX_GEM_TYPES];	// the same gems one mask per color
+};
+
+namespace BoardGenerator
+{
+	// one pass over the cells, see generate
+	template <int ROWS, int COLS, int MAX_GEM_TYPES>
+	void generateMatchFree(Random& random, int numGemTypes, BasicBoardLayout<ROWS, COLS, MAX_GEM_TYPES>& layout)
+	{
+		typedef BitBoard<ROWS, COLS, MAX_GEM_TYPES> Bits;
+		const int kNone = MAX_GEM_TYPES;
+
+		for (int color = 0; color < MAX_GEM_TYPES; ++color)
+		{
+			layout.gemMasks[color] = 0;
+		}
+
+		for (int row = 0; row < ROWS; ++row)
+		{
+			for (int col = 0; col < COLS; ++col)
+			{
+				//up to two colors would complete a run, kNone when a side doesn't forbid any.
+				//The colors are random, so nothing here branches on them
+				int forbiddenLeft = kNone;
+				int forbiddenUp = kNone;
+				if (col >= 2)
+				{
+					int left = layout.cells[row][col - 1];
+					forbiddenLeft = left == layout.cells[row][col - 2] ? left : kNone;
+				}
+				if (row >= 2)
+				{
+					int up = layout.cells[row - 1][col];
+					forbiddenUp = up == layout.cells[row - 2][col] ? up : kNone;
+				}
+				int lowest = std::min(forbiddenLeft, forbiddenUp);
+				int highest = forbiddenLeft == forbiddenUp ? kNone : std::max(forbiddenLeft, forbiddenUp);
+				int numAllowed = numGemTypes - (lowest != kNone) - (highest != kNone);
+
+				//the k-th allowed color, skipping over the forbidden ones in increasing order
+				int color = random.nextInt(numAllowed);
+				color += color >= lowest;
+				color += color >= highest;
+
+				layout.cells[row][col] = static_cast<int8_t>(color);
+				layout.gemMasks[color] |= Bits::cellBit(row, col);
+			}
+		}
+	}
+
+	// Fills the cells in one pass, each one picking among the colors that don't complete a run with the two
+	// cells before it on its row or its column. Only draws from random, so the same state gives the same layout.
+	// A layout without any move is drawn again, which almost never happens with 5 or more gem types
+	template <int ROWS, int COLS, int MAX_GEM_TYPES>
+	void generate(Random& random, int numGemTypes, BasicBoardLayout<ROWS, COLS, MAX_GEM_TYPES>& layout)
+	{
+		typedef MoveIndex<ROWS, COLS, MAX_GEM_TYPES> LayoutMoveIndex;
+
+		//two cells can forbid at most two colors
+		assert(numGemTypes >= 3 && numGemTypes <= MAX_GEM_TYPES);
+
+		while (true)
+		{
+			generateMatchFree(random, numGemTypes, layout);
+			BOARD_CROSS_CHECK(!(RunKernel<ROWS, COLS>::findRuns(&layout.cells[0][0])));
+
+			typename LayoutMoveIndex::Mask validRight;
+			typename LayoutMoveIndex::Mask validDown;
+			LayoutMoveIndex::findValidSwaps(layout.gemMasks, LayoutMoveIndex::Bits::kAllCells, numGemTypes, validRight, validDown);
+			if (validRight || validDown)
+				return;
+		}
+	}
+};
+#endif//BOARD_GENERATOR_H
@@ -0,0 +1,162 @@
+#ifndef BOARD_POOL_H
+#define BOARD_POOL_H
+
+#include "BoardFwd.h"
+#include "BoardGenerator.h"
+#include "Random.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// New boards generated ahead of time on a background thread, so starting a game only copies one.
+// The pool picks the seeds of the new games: a board it hands out is exactly the one Board::init(seed)
+// would have generated, so replays don't need the pool to play back.
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+class BasicBoardPool
+{
+public:
+	typedef BasicBoardLayout<ROWS, COLS, MAX_GEM_TYPES> Layout;
+
+	// boards kept ready ahead of the claimed ones
+	static const int kCapacity = 4;
+
+	struct Entry
+	{
+		uint64_t	seed;
+		Layout		layout;
+		Random		random;		// the generator seeded with seed, once the layout was drawn from it
+	};
+
+private:
+	int m_numGemTypes;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	Random m_seeds;
+	// ready boards in the order their seeds were drawn, with room for the claimed ones not taken yet
+	static const int kMaxEntries = 2 * kCapacity;
+	Entry m_entries[kMaxEntries];
+	int m_first;
+	int m_numReady;
+	int m_numClaimed;				// the first ready boards whose seed was already handed out
+	bool m_bQuit;
+	std::thread m_thread;
+
+	BasicBoardPool(const BasicBoardPool&);
+	BasicBoardPool& operator=(const BasicBoardPool&);
+
+	uint64_t drawSeed()
+	{
+		uint64_t high = m_seeds.next();
+		return (high << 32) | m_seeds.next();
+	}
+
+	void threadMain()
+	{
+		Entry entry;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_wakeUp.wait(lock, [this]() { return m_bQuit || (m_numReady - m_numClaimed < kCapacity && m_numReady < kMaxEntries); });
+			if (m_bQuit)
+				return;
+
+			//the seeds are drawn in order, so the ready boards stay in the order they are handed out
+			uint64_t seed = drawSeed();
+			lock.unlock();
+			generate(seed, m_numGemTypes, entry);
+			lock.lock();
+
+			m_entries[(m_first + m_numReady) % kMaxEntries] = entry;
+			++m_numReady;
+		}
+	}
+
+public:
+	BasicBoardPool(int numGemTypes, uint64_t seed) :
+		m_numGemTypes(numGemTypes),
+		m_seeds(seed),
+		m_first(0),
+		m_numReady(0),
+		m_numClaimed(0),
+		m_bQuit(false)
+	{
+		m_thread = std::thread(&BasicBoardPool::threadMain, this);
+	}
+
+	~BasicBoardPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bQuit = true;
+		}
+		m_wakeUp.notify_one();
+		m_thread.join();
+	}
+
+	// what Board::init(seed) generates, on the calling thread
+	static void generate(uint64_t seed, int numGemTypes, Entry& entry)
+	{
+		entry.seed = seed;
+		entry.random.setSeed(seed);
+		BoardGenerator::generate(entry.random, numGemTypes, entry.layout);
+	}
+
+	// any thread. The seed of the next new game, most of the time its board is ready already
+	uint64_t claimSeed()
+	{
+		uint64_t seed;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_numClaimed < m_numReady)
+			{
+				seed = m_entries[(m_first + m_numClaimed++) % kMaxEntries].seed;
+			}
+			else
+			{
+				//nothing ready, the board will be generated by whoever starts it
+				seed = drawSeed();
+			}
+		}
+		//the worker is woken here rather than in take, which runs in the middle of a game step
+		m_wakeUp.notify_one();
+		return seed;
+	}
+
+	// any thread. Copies the board of a claimed seed if it is ready, otherwise returns false and it has to be generated
+	bool take(uint64_t seed, Entry& entry)
+	{
+		bool bWasFull;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			//the claimed seeds start in order, the ones before seed were handed out but never started
+			int idx = 0;
+			while (idx < m_numClaimed && m_entries[(m_first + idx) % kMaxEntries].seed != seed)
+			{
+				++idx;
+			}
+			if (idx == m_numClaimed)
+				return false;
+
+			bWasFull = m_numReady == kMaxEntries;
+			entry = m_entries[(m_first + idx) % kMaxEntries];
+			m_first = (m_first + idx + 1) % kMaxEntries;
+			m_numReady -= idx + 1;
+			m_numClaimed -= idx + 1;
+		}
+		if (bWasFull)
+		{
+			m_wakeUp.notify_one();
+		}
+		return true;
+	}
+
+	// any thread. The boards ready and not claimed yet
+	int getNumReady()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_numReady - m_numClaimed;
+	}
+};
+#endif//BOARD_POOL_H
@@ -0,0 +1,68 @@
+#ifndef BOARD_SNAPSHOT_H
+#define BOARD_SNAPSHOT_H
+
+#include "Board.h"
+
+#include <SDL_rect.h>
+
+#include <cstdint>
+
+// Everything needed to draw one simulated state of the board, copied out of Board so it can be
+// rendered on another thread while the board keeps changing.
+template <int ROWS, int COLS, int MAX_GEM_TYPES>
+struct BasicBoardSnapshot
+{
+	static const int kMaxGems = BasicBoard<ROWS, COLS, MAX_GEM_TYPES>::kMaxMovingGems;
+	static const int8_t kNoStaticGem = -1;
+
+	struct Gem
+	{
+		int x;
+		int y;
+		int prevX;	// position at the previous update, the renderer blends between the two
+		int prevY;
+		int8_t color;
+	};
+	// the gems resting in their cell, kNoStaticGem where there is none. They are kept apart from the
+	// moving ones so the renderer can cache them and only redraw the cells that changed
+	int8_t staticCells[ROWS][COLS];
+	// swapping and falling gems
+	Gem gems[kMaxGems];
+	int numGems;
+
+	bool hasSelection;
+	SDL_Rect selectionRect;
+	bool hasHint;
+	SDL_Rect hintRect;
+
+	int score;
+	int secondsLeft;
+	bool startGameTextVisible;
+	bool gameOverTextVisible;
+	bool animating;			// gems are moving or the timer is running, the next snapshots will look different
+
+	uint64_t stateCount;	// performance counter time the state corresponds to
+	double step_s;			// time between two updates
+
+	BasicBoardSnapshot() :
+		numGems(0),
+		hasSelection(false),
+		hasHint(false),
+		score(0),
+		secondsLeft(0),
+		startGameTextVisible(false),
+		gameOverTextVisible(false),
+		animating(false),
+		stateCount(0),
+		step_s(0.0)
+	{
+		for (int row = 0; row < ROWS; ++row)
+		{
+			for (int col = 0; col < COLS; ++col)
+			{
+				staticCells[row][col] = kNoStaticGem;
+			}
+		}
+	}
+};
+#endif//BOARD_SNAPSHOT_H
@@ -0,0 +1,160 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <cstdint>
+#include <assert.h>
+
+// Time ordered queue of events, at most one per id in [0, Capacity), e.g. one per GemTable slot.
+// A binary heap that knows where each id sits in it, so an event can be moved or cancelled in O(log n)
+// without leaving a stale entry behind. Events at the same time come out by increasing id, except the ones
+// scheduled right after another event
+template <int Capacity>
+class EventQueue
+{
+private:
+	static const int16_t kNotQueued = -1;
+
+	double	m_time[Capacity];		// by id
+	int32_t	m_order[Capacity];		// by id, breaks the ties of time: id * Capacity, plus one per event chained after it
+	int16_t	m_heapIdx[Capacity];	// by id, kNotQueued when it has no event
+	int16_t	m_heap[Capacity];		// ids
+	int		m_size;
+
+	bool isBefore(int idA, int idB) const
+	{
+		return m_time[idA] < m_time[idB] || (m_time[idA] == m_time[idB] && m_order[idA] < m_order[idB]);
+	}
+
+	void place(int heapIdx, int id)
+	{
+		m_heap[heapIdx] = static_cast<int16_t>(id);
+		m_heapIdx[id] = static_cast<int16_t>(heapIdx);
+	}
+
+	void siftUp(int heapIdx)
+	{
+		int id = m_heap[heapIdx];
+		while (heapIdx > 0)
+		{
+			int parent = (heapIdx - 1) / 2;
+			if (!isBefore(id, m_heap[parent]))
+				break;
+			place(heapIdx, m_heap[parent]);
+			heapIdx = parent;
+		}
+		place(heapIdx, id);
+	}
+
+	void siftDown(int heapIdx)
+	{
+		int id = m_heap[heapIdx];
+		while (true)
+		{
+			int child = 2 * heapIdx + 1;
+			if (child >= m_size)
+				break;
+			if (child + 1 < m_size && isBefore(m_heap[child + 1], m_heap[child]))
+				++child;
+			if (!isBefore(m_heap[child], id))
+				break;
+			place(heapIdx, m_heap[child]);
+			heapIdx = child;
+		}
+		place(heapIdx, id);
+	}
+
+	void schedule(int id, double time, int32_t order)
+	{
+		assert(id >= 0 && id < Capacity);
+		if (m_heapIdx[id] == kNotQueued)
+		{
+			m_time[id] = time;
+			m_order[id] = order;
+			place(m_size++, id);
+			siftUp(m_size - 1);
+		}
+		else if (time < m_time[id] || (time == m_time[id] && order < m_order[id]))
+		{
+			m_time[id] = time;
+			m_order[id] = order;
+			siftUp(m_heapIdx[id]);
+		}
+		else if (time > m_time[id] || order > m_order[id])
+		{
+			m_time[id] = time;
+			m_order[id] = order;
+			siftDown(m_heapIdx[id]);
+		}
+	}
+
+public:
+	EventQueue()
+	{
+		static_assert(Capacity <= 0x7FFF, "EventQueue indices are stored on 16 bits.");
+		for (int i = 0; i < Capacity; ++i)
+		{
+			m_heapIdx[i] = kNotQueued;
+		}
+		m_size = 0;
+	}
+
+	void clear()
+	{
+		for (int i = 0; i < m_size; ++i)
+		{
+			m_heapIdx[m_heap[i]] = kNotQueued;
+		}
+		m_size = 0;
+	}
+
+	bool empty() const { return m_size == 0; }
+	int size() const { return m_size; }
+	bool isQueued(int id) const { assert(id >= 0 && id < Capacity); return m_heapIdx[id] != kNotQueued; }
+	double getTime(int id) const { assert(isQueued(id)); return m_time[id]; }
+
+	// queues the event of id, or moves it if it is already queued
+	void schedule(int id, double time)
+	{
+		schedule(id, time, id * Capacity);
+	}
+
+	// queues the event of id right after the queued event of prevId, at the same time. Nothing else comes out
+	// in between, unless another event is chained after prevId too
+	void scheduleAfter(int id, int prevId)
+	{
+		assert(isQueued(prevId));
+		schedule(id, m_time[prevId], m_order[prevId] + 1);
+	}
+
+	// whether an event of id at time would come out before the queued event of otherId
+	bool wouldComeBefore(int id, double time, int otherId) const
+	{
+		assert(isQueued(otherId));
+		return time < m_time[otherId] || (time == m_time[otherId] && id * Capacity < m_order[otherId]);
+	}
+
+	void cancel(int id)
+	{
+		if (!isQueued(id))
+			return;
+		int heapIdx = m_heapIdx[id];
+		m_heapIdx[id] = kNotQueued;
+		int last = m_heap[--m_size];
+		if (heapIdx == m_size)
+			return;
+		place(heapIdx, last);
+		siftUp(heapIdx);
+		siftDown(m_heapIdx[last]);
+	}
+
+	int topId() const { assert(!empty()); return m_heap[0]; }
+	double topTime() const { assert(!empty()); return m_time[m_heap[0]]; }
+
+	int pop()
+	{
+		int id = topId();
+		cancel(id);
+		return id;
+	}
+};
+#endif//EVENT_QUEUE_H
@@ -0,0 +1,52 @@
+#include "FrameClock.h"
+
+#include <SDL_timer.h>
+
+#include <assert.h>
+
+FrameClock::FrameClock(double step_ms, int maxStepsPerFrame) :
+	m_step_s(step_ms * 0.001),
+	m_maxStepsPerFrame(maxStepsPerFrame),
+	m_secondsPerCount(1.0 / static_cast<double>(SDL_GetPerformanceFrequency())),
+	m_lastCount(0),
+	m_accumulator_s(0.0),
+	m_frameTime_s(0.0)
+{
+	assert(step_ms > 0.0 && maxStepsPerFrame > 0);
+	reset();
+}
+
+void FrameClock::reset()
+{
+	m_lastCount = SDL_GetPerformanceCounter();
+	m_accumulator_s = 0.0;
+	m_frameTime_s = 0.0;
+}
+
+float FrameClock::computeAlpha(uint64_t stateCount, double step_s)
+{
+	uint64_t count = SDL_GetPerformanceCounter();
+	if (count <= stateCount)
+		return 0.f;
+
+	double elapsed_s = (count - stateCount) / static_cast<double>(SDL_GetPerformanceFrequency());
+	double alpha = elapsed_s / step_s;
+	return alpha < 1.0 ? static_cast<float>(alpha) : 1.f;
+}
+
+int FrameClock::advance()
+{
+	uint64_t count = SDL_GetPerformanceCounter();
+	m_frameTime_s = (count - m_lastCount) * m_secondsPerCount;
+	m_lastCount = count;
+
+	m_accumulator_s += m_frameTime_s;
+	int numSteps = static_cast<int>(m_accumulator_s / m_step_s);
+	m_accumulator_s -= numSteps * m_step_s;
+
+	if (numSteps > m_maxStepsPerFrame)
+	{
+		numSteps = m_maxStepsPerFrame;
+	}
+	return numSteps;
+}
@@ -0,0 +1,41 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <cstdint>
+
+// Turns the real time between frames into a whole number of fixed simulation steps.
+// The time left over is carried to the next frame and exposed as the interpolation alpha
+// between the last two simulated states.
+class FrameClock
+{
+private:
+	double m_step_s;
+	int m_maxStepsPerFrame;
+
+	double m_secondsPerCount;
+	uint64_t m_lastCount;
+	double m_accumulator_s;
+	double m_frameTime_s;
+
+public:
+	FrameClock(double step_ms, int maxStepsPerFrame);
+
+	// restarts measuring from now, e.g. after a long load
+	void	reset();
+	// measures the time since the last call and returns how many steps to simulate for it.
+	// If the simulation can't keep up, the steps past maxStepsPerFrame are dropped 
+	// instead of piling up over the next frames
+	int		advance();
+
+	float	getAlpha() const		{ return static_cast<float>(m_accumulator_s / m_step_s); }
+	float	getStep_ms() const		{ return static_cast<float>(m_step_s * 1000.0); }
+	double	getFrameTime_s() const	{ return m_frameTime_s; }
+	double	getStep_s() const		{ return m_step_s; }
+	double	getTimeToNextStep_s() const	{ return m_step_s - m_accumulator_s; }
+
+	// performance counter time the last simulated step corresponds to
+	uint64_t	getStateCount() const	{ return m_lastCount - static_cast<uint64_t>(m_accumulator_s / m_secondsPerCount); }
+	// how far now is between the state at stateCount and the next one, for another thread to interpolate
+	static float	computeAlpha(uint64_t stateCount, double step_s);
+};
+#endif//FRAME_CLOCK_H
@@ -0,0 +1,62 @@
+#include "FramePacer.h"
+
+#include <SDL_timer.h>
+
+#include <assert.h>
+
+FramePacer::FramePacer(int idleWait_ms, int activeFrames) :
+	m_idleWait_ms(idleWait_ms),
+	m_activeFrames(activeFrames),
+	m_activeFramesLeft(activeFrames),
+	m_minFrameCounts(0),
+	m_nextFrameCount(0),
+	m_numPresented(0),
+	m_numSkipped(0)
+{
+	assert(idleWait_ms > 0 && activeFrames > 0);
+}
+
+void FramePacer::setMaxFps(int maxFps)
+{
+	m_minFrameCounts = maxFps > 0 ? SDL_GetPerformanceFrequency() / maxFps : 0;
+	m_nextFrameCount = SDL_GetPerformanceCounter();
+}
+
+bool FramePacer::beginFrame(bool animating)
+{
+	if (animating)
+	{
+		onActivity();
+	}
+
+	if (m_activeFramesLeft == 0)
+	{
+		++m_numSkipped;
+		return false;
+	}
+	--m_activeFramesLeft;
+	++m_numPresented;
+	return true;
+}
+
+void FramePacer::endFrame(bool presented)
+{
+	if (!presented || m_minFrameCounts == 0)
+		return;
+
+	//the deadlines are kept on a fixed grid, so a late frame doesn't push all the next ones back
+	uint64_t count = SDL_GetPerformanceCounter();
+	m_nextFrameCount += m_minFrameCounts;
+	if (m_nextFrameCount < count)
+	{
+		m_nextFrameCount = count;
+		return;
+	}
+
+	//sleeping whole ms can end a frame a bit early, the fixed grid makes up for it over the next ones
+	uint64_t wait_ms = (m_nextFrameCount - count) * 1000 / SDL_GetPerformanceFrequency();
+	if (wait_ms > 0)
+	{
+		SDL_Delay(static_cast<Uint32>(wait_ms));
+	}
+}
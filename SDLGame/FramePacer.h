@@ -0,0 +1,43 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+
+// Decides when the main loop draws. While something moves every frame is presented; once nothing
+// has changed for a few frames the loop goes idle: it stops presenting and blocks on events instead.
+// Without vsync it also holds the presents to a maximum frame rate.
+class FramePacer
+{
+private:
+	int m_idleWait_ms;
+	int m_activeFrames;
+	int m_activeFramesLeft;
+
+	uint64_t m_minFrameCounts;		// 0 when the presents are already paced by vsync
+	uint64_t m_nextFrameCount;
+	uint64_t m_numPresented;
+	uint64_t m_numSkipped;
+
+public:
+	// activeFrames is how many frames are still presented after the last change, so the final state
+	// and the reaction to an input make it to the screen even if the simulation publishes them a bit later
+	FramePacer(int idleWait_ms, int activeFrames);
+
+	// maxFps 0 turns the limiter off, e.g. when the renderer has vsync
+	void	setMaxFps(int maxFps);
+
+	// an input or window event arrived
+	void	onActivity()			{ m_activeFramesLeft = m_activeFrames; }
+	bool	isIdle() const			{ return m_activeFramesLeft == 0; }
+	// how long an idle loop may block waiting for events before it looks at the simulation again
+	int		getIdleWait_ms() const	{ return m_idleWait_ms; }
+
+	// returns whether this frame should be drawn and presented
+	bool	beginFrame(bool animating);
+	// waits for the frame limiter if the frame was presented
+	void	endFrame(bool presented);
+
+	uint64_t	getNumPresented() const	{ return m_numPresented; }
+	uint64_t	getNumSkipped() const	{ return m_numSkipped; }
+};
+#endif//FRAME_PACER_H
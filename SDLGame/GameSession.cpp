@@ -0,0 +1,102 @@
+#include "GameSession.h"
+#include "Board.h"
+#include "Replay.h"
+#include "AllocCounter.h"
+
+#include <assert.h>
+
+GameSession::GameSession(Board& board, uint64_t seed, float step_ms) :
+	m_board(board),
+	m_step_ms(step_ms),
+	m_gameState(EGS_WaitingToStartGame),
+	m_tick(0),
+	m_pRecorder(nullptr)
+{
+	m_board.init(seed);
+	m_board.setGameRunning(false);
+}
+
+void GameSession::setRecorder(ReplayRecorder* recorder)
+{
+	assert(m_tick == 0 && "The recording must start with the session");
+	m_pRecorder = recorder;
+	if (m_pRecorder)
+	{
+		m_pRecorder->begin(m_board.getNumGemTypes(), m_board.getSeed(), m_step_ms);
+		m_pRecorder->recordChecksum(m_tick, m_board.computeChecksum());
+	}
+}
+
+void GameSession::finishRecording()
+{
+	if (m_pRecorder)
+	{
+		m_pRecorder->end(m_tick);
+		m_pRecorder = nullptr;
+	}
+}
+
+void GameSession::handleInput(const InputEvent& event)
+{
+	if (m_pRecorder)
+	{
+		m_pRecorder->recordInput(m_tick, event);
+	}
+
+	switch (event.type)
+	{
+		case InputEvent::EIT_START_GAME:
+			if (m_gameState == EGS_WaitingToStartGame)
+			{
+				m_board.setGameRunning(true);
+				m_gameState = EGS_GameRunning;
+			}
+			break;
+		case InputEvent::EIT_RESTART_GAME:
+		{
+			//a restart reuses everything the board already has
+			ASSERT_NO_ALLOC_SCOPE("board restart");
+			m_board.init(event.seed);
+			m_board.setGameRunning(true);
+			m_gameState = EGS_GameRunning;
+			break;
+		}
+		case InputEvent::EIT_SHOW_HINT:
+			if (m_gameState == EGS_GameRunning)
+			{
+				m_board.setHintVisible(true);
+			}
+			break;
+		case InputEvent::EIT_MOUSE_DOWN:
+		case InputEvent::EIT_MOUSE_UP:
+			if (m_gameState == EGS_GameRunning)
+			{
+				ASSERT_NO_ALLOC_SCOPE("board input");
+				m_board.mouseEvent(event.x, event.y, event.type == InputEvent::EIT_MOUSE_DOWN);
+			}
+			break;
+		default:
+			assert(false && "Unknown input event");
+	}
+}
+
+void GameSession::step()
+{
+	{
+		//the board runs out of fixed size storage, a frame must never touch the heap
+		ASSERT_NO_ALLOC_SCOPE("board update");
+		m_board.update(m_step_ms);
+	}
+	++m_tick;
+
+	if (m_gameState == EGS_GameRunning && m_board.getSecondsLeft() == 0)
+	{
+		m_board.setGameRunning(false);
+		m_gameState = EGS_GameOver;
+	}
+
+	if (m_pRecorder)
+	{
+		m_pRecorder->recordChecksum(m_tick, m_board.computeChecksum());
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef GAME_SESSION_H
+#define GAME_SESSION_H
+
+#include "BoardFwd.h"
+
+#include <cstdint>
+
+class ReplayRecorder;
+
+enum EGameState
+{ 
+	EGS_WaitingToStartGame = 0,
+	EGS_GameRunning,
+	EGS_GameOver
+};
+
+// Everything the player can do to the game, in the order it reaches the simulation
+struct InputEvent
+{
+	enum EType
+	{
+		EIT_MOUSE_DOWN,
+		EIT_MOUSE_UP,
+		EIT_START_GAME,
+		EIT_RESTART_GAME,
+		EIT_SHOW_HINT,
+		EIT_COUNT
+	};
+	EType type;
+	int x;
+	int y;
+	uint64_t seed;	// the seed of the new board for EIT_RESTART_GAME
+
+	InputEvent() : type(EIT_MOUSE_DOWN), x(0), y(0), seed(0) {}
+	InputEvent(EType type, int x = 0, int y = 0) : type(type), x(x), y(y), seed(0) {}
+};
+
+// The game rules around a Board: starting, restarting and ending games, stepped in fixed ticks.
+// All the input goes through handleInput, so a session fully determined by its seed and its input, 
+// which is what a ReplayRecorder captures.
+class GameSession
+{
+private:
+	Board& m_board;
+	float m_step_ms;
+	EGameState m_gameState;
+	uint32_t m_tick;
+
+	ReplayRecorder* m_pRecorder;
+
+	GameSession(const GameSession&);
+	GameSession& operator=(const GameSession&);
+
+public:
+	// starts from a new board made from seed, waiting for EIT_START_GAME
+	GameSession(Board& board, uint64_t seed, float step_ms);
+
+	// records everything from now on, must be set before the first input or step
+	void	setRecorder(ReplayRecorder* recorder);
+	// writes the end of the recording
+	void	finishRecording();
+
+	void	handleInput(const InputEvent& event);
+	void	step();
+
+	Board&		getBoard()				{ return m_board; }
+	EGameState	getGameState() const	{ return m_gameState; }
+	uint32_t	getTick() const			{ return m_tick; }
+	float		getStep_ms() const		{ return m_step_ms; }
+};
+#endif//GAME_SESSION_H
@@ -0,0 +1,169 @@
+#include "GameSimulation.h"
+#include "Board.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace std;
+
+// idle sleeps are capped so the input that arrives in between waits at most this long
+static const double kMaxIdleSleep_s = 0.002;
+// a settled board only has its timer running, so it can wait longer
+static const double kMaxSettledSleep_s = 0.01;
+static const int kProfileSummarySteps = 30;
+
+GameSimulation::GameSimulation(Board& board, uint64_t seed, double step_ms, int maxStepsPerFrame) :
+	m_clock(step_ms, maxStepsPerFrame),
+	m_session(board, seed, m_clock.getStep_ms()),
+	m_summaryCountdown(kProfileSummarySteps),
+	m_bAnimating(true),
+	m_bQuit(false),
+	m_bWakeUp(false)
+{
+	//the main thread must have something to draw before the first step
+	publishSnapshot();
+}
+
+GameSimulation::~GameSimulation()
+{
+	stop();
+}
+
+void GameSimulation::start()
+{
+	assert(!m_thread.joinable());
+	m_profiler.setEnabled(Profiler::instance().isEnabled());
+	m_profiler.setTraceHandover(&m_traceEvents);
+	m_bQuit.store(false);
+	m_thread = thread(&GameSimulation::threadMain, this);
+}
+
+void GameSimulation::stop()
+{
+	if (m_thread.joinable())
+	{
+		m_bQuit.store(true);
+		wakeUp();
+		m_thread.join();
+	}
+	m_session.finishRecording();
+}
+
+void GameSimulation::threadMain()
+{
+	Profiler::setThreadInstance(&m_profiler);
+	m_clock.reset();
+
+	while (!m_bQuit.load())
+	{
+		int numSteps = m_clock.advance();
+		bool changed = processInput();
+
+		if (numSteps > 0)
+		{
+			m_profiler.beginFrame();
+			{
+				PROFILE_SCOPE(EPS_BOARD_UPDATE);
+				for (int i = 0; i < numSteps; ++i)
+				{
+					m_session.step();
+				}
+			}
+			m_profiler.endFrame();
+
+			if (m_profiler.isEnabled() && --m_summaryCountdown <= 0)
+			{
+				m_profiler.getSummary(m_profileSummaries.getWriteBuffer());
+				m_profileSummaries.publish();
+				m_summaryCountdown = kProfileSummarySteps;
+			}
+			changed = true;
+		}
+
+		if (changed)
+		{
+			publishSnapshot();
+		}
+
+		if (!m_bAnimating && m_session.getGameState() != EGS_GameRunning)
+		{
+			//on the start and game over screens nothing happens until an input arrives. The steps skipped
+			//while waiting wouldn't have changed anything, the clock starts again from the wake up
+			waitForWakeUp();
+			m_clock.reset();
+		}
+		else
+		{
+			double sleep_s = min(m_clock.getTimeToNextStep_s(), m_bAnimating ? kMaxIdleSleep_s : kMaxSettledSleep_s);
+			this_thread::sleep_for(chrono::microseconds(static_cast<long long>(sleep_s * 1e6)));
+		}
+	}
+
+	Profiler::setThreadInstance(nullptr);
+}
+
+void GameSimulation::waitForWakeUp()
+{
+	unique_lock<mutex> lock(m_wakeUpMutex);
+	m_wakeUp.wait(lock, [this]() { return m_bWakeUp; });
+	m_bWakeUp = false;
+}
+
+void GameSimulation::wakeUp()
+{
+	{
+		lock_guard<mutex> lock(m_wakeUpMutex);
+		m_bWakeUp = true;
+	}
+	m_wakeUp.notify_one();
+}
+
+bool GameSimulation::pushInput(const InputEvent& event)
+{
+	if (!m_input.push(event))
+		return false;
+
+	wakeUp();
+	return true;
+}
+
+bool GameSimulation::processInput()
+{
+	bool processed = false;
+	InputEvent event;
+	while (m_input.pop(event))
+	{
+		processed = true;
+		m_session.handleInput(event);
+	}
+	return processed;
+}
+
+void GameSimulation::publishSnapshot()
+{
+	BoardSnapshot& snapshot = m_snapshots.getWriteBuffer();
+	m_session.getBoard().takeSnapshot(snapshot);
+	snapshot.startGameTextVisible = (m_session.getGameState() == EGS_WaitingToStartGame);
+	snapshot.gameOverTextVisible = (m_session.getGameState() == EGS_GameOver);
+	snapshot.stateCount = m_clock.getStateCount();
+	snapshot.step_s = m_clock.getStep_s();
+	m_bAnimating = snapshot.animating;
+	m_snapshots.publish();
+}
+
+const BoardSnapshot& GameSimulation::acquireSnapshot()
+{
+	m_snapshots.acquire();
+	return m_snapshots.getReadBuffer();
+}
+
+bool GameSimulation::acquireProfileSummary(ProfileSummary& summary)
+{
+	if (!m_profileSummaries.acquire())
+		return false;
+
+	summary = m_profileSummaries.getReadBuffer();
+	return true;
+}
@@ -0,0 +1,78 @@
+#ifndef GAME_SIMULATION_H
+#define GAME_SIMULATION_H
+
+#include "BoardSnapshot.h"
+#include "FrameClock.h"
+#include "GameSession.h"
+#include "Profiler.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class ReplayRecorder;
+
+// Runs the game rules and the board in fixed steps on its own thread.
+// The main thread only pushes input and draws the latest published snapshot, so a slow present
+// or a vsync wait never holds back the simulation or the handling of input.
+class GameSimulation
+{
+public:
+	static const unsigned int kInputQueueSize = 256;
+	static const int kTraceThreadId = 2;		// of the board scopes in a trace capture
+
+private:
+	FrameClock m_clock;
+	GameSession m_session;		// only touched by the simulation thread once started
+
+	SpscQueue<InputEvent, kInputQueueSize> m_input;		// main thread -> simulation
+	TripleBuffer<BoardSnapshot> m_snapshots;			// simulation -> main thread
+	TripleBuffer<ProfileSummary> m_profileSummaries;	// simulation -> main thread
+	ProfileTraceQueue m_traceEvents;					// simulation -> main thread
+
+	// the board scopes are timed on the simulation thread, which can't share the main profiler
+	Profiler m_profiler;
+	int m_summaryCountdown;
+	bool m_bAnimating;			// as of the last published snapshot
+
+	std::thread m_thread;
+	std::atomic<bool> m_bQuit;
+
+	// wakes the simulation thread up when it waits for input with nothing to simulate
+	std::mutex m_wakeUpMutex;
+	std::condition_variable m_wakeUp;
+	bool m_bWakeUp;
+
+	GameSimulation(const GameSimulation&);
+	GameSimulation& operator=(const GameSimulation&);
+
+	void threadMain();
+	void waitForWakeUp();
+	void wakeUp();
+	bool processInput();
+	void publishSnapshot();
+
+public:
+	GameSimulation(Board& board, uint64_t seed, double step_ms, int maxStepsPerFrame);
+	~GameSimulation();
+
+	// must be called before start, the recording is finished by stop
+	void setRecorder(ReplayRecorder* recorder)	{ m_session.setRecorder(recorder); }
+
+	void start();
+	void stop();
+
+	// main thread. Returns false if the simulation is too far behind and the event was dropped
+	bool	pushInput(const InputEvent& event);
+	// main thread. Switches to the newest snapshot if a new one was published, 
+	// the returned one stays valid until the next call
+	const BoardSnapshot&	acquireSnapshot();
+	// main thread. Returns true and fills summary if the simulation published new timings
+	bool	acquireProfileSummary(ProfileSummary& summary);
+	// main thread. Returns false once every scope the simulation timed was popped
+	bool	popTraceEvent(ProfileTraceEvent& event)		{ return m_traceEvents.pop(event); }
+};
+#endif//GAME_SIMULATION_H
@@ -0,0 +1,164 @@
+#ifndef GEM_TABLE_H
+#define GEM_TABLE_H
+
+#include <cstdint>
+#include <assert.h>
+
+// Refers to one gem of a GemTable: the slot in the low 16 bits, the generation of the slot in the high 16 bits.
+// A handle kept after its gem was released is detected as stale, even once the slot holds another gem
+typedef uint32_t GemHandle;
+static const GemHandle kInvalidGemHandle = 0xFFFFFFFFu;
+
+// Every gem that isn't resting in a cell, stored as a structure of arrays indexed by slot.
+// The capacity is fixed: allocating and releasing gems never moves any of them in memory
+template <int Capacity>
+class GemTable
+{
+public:
+	enum EGemState
+	{
+		EGM_FREE = 0,
+		EGM_SWAPPING,
+		EGM_FALLING
+	};
+
+	// results a swapping gem can get from its partner, when the partner reached its cell first
+	enum EPartnerResult
+	{
+		EPR_NOT_FINISHED = 0,
+		EPR_CHAINED,
+		EPR_DIDNT_CHAIN
+	};
+
+	// every gem. A falling gem keeps its position and velocity at fallStartTime, it only moves on paper
+	float	posX[Capacity];
+	float	posY[Capacity];
+	float	prevPosX[Capacity];		// position before the last update, rendering blends between the two
+	float	prevPosY[Capacity];
+	float	velX[Capacity];			// pixels per second
+	float	velY[Capacity];
+	int8_t	color[Capacity];
+	uint8_t	state[Capacity];
+	int8_t	destRow[Capacity];		// the cell a swapping gem heads to, or the one a falling gem is predicted to land in
+	int8_t	destCol[Capacity];
+
+	// swapping gems only
+	float		targetX[Capacity];
+	float		targetY[Capacity];
+	GemHandle	partner[Capacity];			// the other gem of the swap, kInvalidGemHandle without one
+	uint8_t		partnerResult[Capacity];
+
+	// falling gems only
+	double		fallStartTime[Capacity];	// seconds, on the clock of the board falls
+
+private:
+	uint16_t m_generation[Capacity];
+	uint16_t m_freeSlots[Capacity];
+	int m_numFree;
+
+public:
+	static int handleSlot(GemHandle handle) { return static_cast<int>(handle & 0xFFFF); }
+
+	GemTable()
+	{
+		for (int i = 0; i < Capacity; ++i)
+		{
+			m_generation[i] = 0;
+			state[i] = EGM_FREE;
+		}
+		clear();
+	}
+
+	// releases every gem, all the handles given so far become stale
+	void clear()
+	{
+		m_numFree = Capacity;
+		for (int i = 0; i < Capacity; ++i)
+		{
+			if (state[i] != EGM_FREE)
+			{
+				++m_generation[i];
+				state[i] = EGM_FREE;
+			}
+			//hand the low slots out first
+			m_freeSlots[i] = static_cast<uint16_t>(Capacity - 1 - i);
+		}
+	}
+
+	GemHandle allocate(EGemState gemState)
+	{
+		assert(m_numFree > 0 && "GemTable is full");
+		assert(gemState != EGM_FREE);
+		int slot = m_freeSlots[--m_numFree];
+		state[slot] = static_cast<uint8_t>(gemState);
+		return (static_cast<GemHandle>(m_generation[slot]) << 16) | static_cast<GemHandle>(slot);
+	}
+
+	void release(GemHandle handle)
+	{
+		assert(isAlive(handle));
+		int slot = handleSlot(handle);
+		state[slot] = EGM_FREE;
+		++m_generation[slot];
+		m_freeSlots[m_numFree++] = static_cast<uint16_t>(slot);
+	}
+
+	bool isAlive(GemHandle handle) const
+	{
+		int slot = handleSlot(handle);
+		return handle != kInvalidGemHandle && slot < Capacity &&
+				state[slot] != EGM_FREE && m_generation[slot] == static_cast<uint16_t>(handle >> 16);
+	}
+
+	// the slot of a live gem, to index the arrays with
+	int slot(GemHandle handle) const
+	{
+		assert(isAlive(handle));
+		return handleSlot(handle);
+	}
+
+	int getNumAlive() const { return Capacity - m_numFree; }
+};
+
+// Fixed capacity list of gem handles, e.g. all the gems in one state.
+// The order is kept unless removeSwapLast is used
+template <int Capacity>
+class GemList
+{
+private:
+	GemHandle m_handles[Capacity];
+	int m_size;
+
+public:
+	GemList() : m_size(0) {}
+
+	int size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	void clear() { m_size = 0; }
+
+	GemHandle operator[](int idx) const { assert(idx >= 0 && idx < m_size); return m_handles[idx]; }
+
+	void push_back(GemHandle handle)
+	{
+		assert(m_size < Capacity && "GemList is full");
+		m_handles[m_size++] = handle;
+	}
+
+	// O(1), the last handle takes the place of the removed one
+	void removeSwapLast(int idx)
+	{
+		assert(idx >= 0 && idx < m_size);
+		m_handles[idx] = m_handles[--m_size];
+	}
+
+	void removeOrdered(int idx)
+	{
+		assert(idx >= 0 && idx < m_size);
+		for (int i = idx + 1; i < m_size; ++i)
+		{
+			m_handles[i - 1] = m_handles[i];
+		}
+		--m_size;
+	}
+};
+#endif//GEM_TABLE_H
@@ -1,18 +1,24 @@
 #include "GraphicsMgr.h"
 #include "AssetMgr.h"
 #include "Board.h"
+#include "BoardSnapshot.h"
 #include "Common.h"
+#include "Profiler.h"
 
 #include <SDL.h>
 #include <SDL_ttf.h>
 
-#include <sstream>
+#include <cstring>
 
 #include <assert.h>
 
 
 
 using namespace std;
+using namespace Utils;
+
+//static gems plus the ones falling into a fully cleared board
+static const int kMaxGemSprites = 2 * kBoardRows * kBoardCols;
 
 GraphicsMgr::GraphicsMgr(const char* title, 
 						 int x, int y, 
@@ -24,6 +30,9 @@ GraphicsMgr::GraphicsMgr(const char* title,
 	m_bDebugDraw(false),
 	m_pAssetMgr(nullptr),
 	m_pBoard(nullptr),
+	m_gemBatch(kMaxGemSprites),
+	m_pBoardLayerTex(nullptr),
+	m_bBoardLayerValid(false),
 	m_scoreX(scoreX),
 	m_scoreY(scoreY),
 	m_timeX(timeX),
@@ -32,12 +41,11 @@ GraphicsMgr::GraphicsMgr(const char* title,
 	m_gameOverY(gameOverY),
 	m_startGameX(startGameX),
 	m_startGameY(startGameY),
-	m_pScoreTex(nullptr),
-	m_pTimeTex(nullptr),
 	m_pGameOverTex(nullptr),
 	m_pStartGameTex(nullptr),
 	m_bStartGameTextVisible(false),
-	m_bGameOverTextVisible(false)
+	m_bGameOverTextVisible(false),
+	m_bProfilerOverlayVisible(false)
 {
 	m_pWindow = SDL_CreateWindow(title, x, y, w, h, SDL_WINDOW_SHOWN);
 	if (!m_pWindow)
@@ -53,19 +61,30 @@ GraphicsMgr::GraphicsMgr(const char* title,
 		Utils::logSDLError("CreateRenderer");
 		exit(1);
 	}
-	
+
+	createBoardLayer();
 }
 
 
 GraphicsMgr::~GraphicsMgr(void)
 {
+	SDL_DestroyTexture(m_pBoardLayerTex);
 	SDL_DestroyTexture(m_pStartGameTex);
 	SDL_DestroyTexture(m_pGameOverTex);
+	Profiler::instance().releaseOverlay();
+	m_textAtlas.release();
+	m_smallTextAtlas.release();
 
 	SDL_DestroyRenderer(m_pRenderer);
 	SDL_DestroyWindow(m_pWindow);
 }
 
+bool GraphicsMgr::hasVsync() const
+{
+	SDL_RendererInfo info;
+	return SDL_GetRendererInfo(m_pRenderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+}
+
 void GraphicsMgr::generateTextTextures()
 {
 	assert (!m_pStartGameTex && !m_pGameOverTex); 
@@ -75,6 +94,21 @@ void GraphicsMgr::generateTextTextures()
 	m_pStartGameTex = renderText("Press 's' to start the game.", EFontType::EFT_FREE_SANS_BIG, color);
 	
 	m_pGameOverTex = renderText("Press 'r' to play again.", EFontType::EFT_FREE_SANS_BIG, color);
+
+	//score and time change all the time, so they are drawn glyph by glyph from an atlas
+	if (!m_textAtlas.build(m_pRenderer, m_pAssetMgr->getFont(EFontType::EFT_FREE_SANS_MEDIUM)))
+	{
+		exit(1);
+	}
+	static const SDL_Color labelColor = { 255, 255, 255, 255 };
+	m_scoreLabel.init(&m_textAtlas, labelColor);
+	m_timeLabel.init(&m_textAtlas, labelColor);
+
+	if (!m_smallTextAtlas.build(m_pRenderer, m_pAssetMgr->getFont(EFontType::EFT_FREE_SANS_SMALL)))
+	{
+		exit(1);
+	}
+	Profiler::instance().initOverlay(&m_smallTextAtlas);
 }
 void GraphicsMgr::renderTexture(SDL_Texture* tex, int x, int y, int w, int h)
 {
@@ -94,35 +128,14 @@ void GraphicsMgr::renderTexture(SDL_Texture* tex, int x, int y)
 	renderTexture(tex, x, y, w, h);
 }
 
-static string itos(int i)
+void GraphicsMgr::update(const BoardSnapshot& snapshot)
 {
-	stringstream s;
-	s << i;
-	return s.str();
-}
-
-void GraphicsMgr::update(float dt_ms)
-{
-	//@TODO: I shouldn't create strings in the loop since it might allocate memory per frame
-	//@TODO: implement a text rendering system that doesn't render the text to a texture each frame
-
-	string text = "Score: ";
-	text += itos(m_pBoard->getScore());
-
-	static const SDL_Color color = { 255, 255, 255 };
-	if (m_pScoreTex)
-	{
-		SDL_DestroyTexture(m_pScoreTex);
-	}
-	m_pScoreTex = renderText(text.c_str(), EFontType::EFT_FREE_SANS_MEDIUM, color);
-	
-	if (m_pTimeTex)
-	{
-		SDL_DestroyTexture(m_pTimeTex);
-	}
-	(text = "Time left: ") += itos(m_pBoard->getSecondsLeft());
-	m_pTimeTex = renderText(text.c_str(), EFontType::EFT_FREE_SANS_MEDIUM, color);
+	//labels only lay out their glyphs again when the value changes
+	m_scoreLabel.setTextWithValue("Score: ", snapshot.score);
+	m_timeLabel.setTextWithValue("Time left: ", snapshot.secondsLeft);
 
+	m_bStartGameTextVisible = snapshot.startGameTextVisible;
+	m_bGameOverTextVisible = snapshot.gameOverTextVisible;
 }
 
 SDL_Texture* GraphicsMgr::renderText(const char* message, EFontType font, SDL_Color color)
@@ -146,15 +159,162 @@ SDL_Texture* GraphicsMgr::renderText(const char* message, EFontType font, SDL_Co
 	return texture;
 }
 
-void GraphicsMgr::render()
+void GraphicsMgr::renderLoadingScreen(float progress)
 {
+	static const int barW = 300;
+	static const int barH = 12;
+
+	SDL_SetRenderDrawColor(m_pRenderer, 0, 0, 0, 255);
 	SDL_RenderClear(m_pRenderer);
-	renderTexture(m_pAssetMgr->getBackgroundTex(), 0, 0);
 
-	m_pBoard->render(m_pRenderer);
+	//the background is the first asset to be uploaded, show it as soon as it is there
+	if (SDL_Texture* bgTex = m_pAssetMgr->getBackgroundTex())
+	{
+		renderTexture(bgTex, 0, 0);
+	}
+
+	int w, h;
+	SDL_GetRendererOutputSize(m_pRenderer, &w, &h);
+	SDL_Rect frame = { (w - barW) / 2, h / 2 - barH / 2, barW, barH };
+	SDL_Rect bar = frame;
+	bar.w = static_cast<int>(barW * progress);
+
+	SDL_SetRenderDrawColor(m_pRenderer, 255, 255, 255, 255);
+	SDL_RenderFillRect(m_pRenderer, &bar);
+	SDL_RenderDrawRect(m_pRenderer, &frame);
+	SDL_SetRenderDrawColor(m_pRenderer, 0, 0, 0, 255);
+
+	SDL_RenderPresent(m_pRenderer);
+}
+
+void GraphicsMgr::createBoardLayer()
+{
+	if (!SDL_RenderTargetSupported(m_pRenderer))
+		return;
+
+	int w, h;
+	SDL_GetRendererOutputSize(m_pRenderer, &w, &h);
+	m_pBoardLayerTex = SDL_CreateTexture(m_pRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+	if (!m_pBoardLayerTex)
+	{
+		Utils::logSDLError("CreateTexture");
+		return;
+	}
+	//it covers the whole window, nothing under it needs to show through
+	SDL_SetTextureBlendMode(m_pBoardLayerTex, SDL_BLENDMODE_NONE);
+}
+
+bool GraphicsMgr::gemsFitInTiles() const
+{
+	SDL_Rect tile;
+	m_pBoard->getTileRect(0, 0, tile);
+	Point pos = m_pBoard->getTileCenter(0, 0);
+	for (int i = 0; i < m_pAssetMgr->getNumGemTypes(); ++i)
+	{
+		const SDL_Rect& gemRect = m_pAssetMgr->getGemRect(i);
+		if (pos.x - tile.x + gemRect.w > tile.w || pos.y - tile.y + gemRect.h > tile.h)
+			return false;
+	}
+	return true;
+}
+
+void GraphicsMgr::addStaticGems(const BoardSnapshot& snapshot)
+{
+	for (int row = 0; row < kBoardRows; ++row)
+	{
+		for (int col = 0; col < kBoardCols; ++col)
+		{
+			int8_t color = snapshot.staticCells[row][col];
+			if (color != BoardSnapshot::kNoStaticGem)
+			{
+				Point pos = m_pBoard->getTileCenter(row, col);
+				m_gemBatch.add(m_pAssetMgr->getGemRect(color), pos.x, pos.y);
+			}
+		}
+	}
+}
+
+void GraphicsMgr::updateBoardLayer(const BoardSnapshot& snapshot)
+{
+	int numChanged = 0;
+	for (int row = 0; row < kBoardRows; ++row)
+	{
+		for (int col = 0; col < kBoardCols; ++col)
+		{
+			numChanged += (snapshot.staticCells[row][col] != m_layerCells[row][col]);
+		}
+	}
+	if (m_bBoardLayerValid && numChanged == 0)
+		return;
+
+	//a cell can only be drawn again on its own if its gem doesn't spill over the neighbours
+	bool rebuild = !m_bBoardLayerValid || !gemsFitInTiles();
+	SDL_Texture* bgTex = m_pAssetMgr->getBackgroundTex();
+
+	SDL_SetRenderTarget(m_pRenderer, m_pBoardLayerTex);
+	m_gemBatch.begin(m_pAssetMgr->getGemAtlasTex());
+	if (rebuild)
+	{
+		SDL_SetRenderDrawColor(m_pRenderer, 0, 0, 0, 255);
+		SDL_RenderClear(m_pRenderer);
+		renderTexture(bgTex, 0, 0);
+		addStaticGems(snapshot);
+	}
+	else
+	{
+		//put the background back under the changed cells, then their new gems on top
+		for (int row = 0; row < kBoardRows; ++row)
+		{
+			for (int col = 0; col < kBoardCols; ++col)
+			{
+				int8_t color = snapshot.staticCells[row][col];
+				if (color == m_layerCells[row][col])
+					continue;
+
+				SDL_Rect tile;
+				m_pBoard->getTileRect(row, col, tile);
+				SDL_RenderCopy(m_pRenderer, bgTex, &tile, &tile);
+				if (color != BoardSnapshot::kNoStaticGem)
+				{
+					Point pos = m_pBoard->getTileCenter(row, col);
+					m_gemBatch.add(m_pAssetMgr->getGemRect(color), pos.x, pos.y);
+				}
+			}
+		}
+	}
+	m_gemBatch.flush(m_pRenderer);
+	SDL_SetRenderTarget(m_pRenderer, nullptr);
+
+	memcpy(m_layerCells, snapshot.staticCells, sizeof(m_layerCells));
+	m_bBoardLayerValid = true;
+}
+
+void GraphicsMgr::render(const BoardSnapshot& snapshot, float alpha)
+{
+	{
+		PROFILE_SCOPE(EPS_BOARD_LAYER);
+		if (m_pBoardLayerTex)
+		{
+			updateBoardLayer(snapshot);
+			SDL_RenderCopy(m_pRenderer, m_pBoardLayerTex, nullptr, nullptr);
+		}
+		else
+		{
+			SDL_RenderClear(m_pRenderer);
+			renderTexture(m_pAssetMgr->getBackgroundTex(), 0, 0);
+			m_gemBatch.begin(m_pAssetMgr->getGemAtlasTex());
+			addStaticGems(snapshot);
+			m_gemBatch.flush(m_pRenderer);
+		}
+	}
+
+	{
+		PROFILE_SCOPE(EPS_BOARD_RENDER);
+		m_pBoard->render(m_pRenderer, snapshot, alpha);
+	}
 	
-	renderTexture(m_pScoreTex, m_scoreX, m_scoreY);
-	renderTexture(m_pTimeTex, m_timeX, m_timeY);
+	m_scoreLabel.render(m_pRenderer, m_scoreX, m_scoreY);
+	m_timeLabel.render(m_pRenderer, m_timeX, m_timeY);
 
 	if (m_bStartGameTextVisible)
 	{
@@ -164,5 +324,12 @@ void GraphicsMgr::render()
 	{
 		renderTexture(m_pGameOverTex, m_gameOverX, m_gameOverY);
 	}
+
+	if (m_bProfilerOverlayVisible)
+	{
+		Profiler::instance().renderOverlay(m_pRenderer, 10, 200);
+	}
+
+	PROFILE_SCOPE(EPS_PRESENT);
 	SDL_RenderPresent(m_pRenderer);
 }
\ No newline at end of file
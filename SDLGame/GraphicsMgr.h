@@ -1,12 +1,17 @@
 #ifndef GRAPHICS_MGR_H
 #define GRAPHICS_MGR_H
 
+#include "TextRenderer.h"
+#include "SpriteBatch.h"
+#include "Board.h"
+
+#include <cstdint>
+
 struct SDL_Texture;
 struct SDL_Renderer;
 struct SDL_Color;
 struct SDL_Window;
 struct SDL_Renderer;
-class Board;
 class AssetMgr;
 enum class EFontType : unsigned int;
 
@@ -21,8 +26,19 @@ protected:
 
 	bool m_bDebugDraw;
 	
-	SDL_Texture* m_pScoreTex;
-	SDL_Texture* m_pTimeTex;
+	GlyphAtlas m_textAtlas;
+	GlyphAtlas m_smallTextAtlas;
+	TextLabel m_scoreLabel;
+	TextLabel m_timeLabel;
+
+	SpriteBatch m_gemBatch;
+
+	// the background with the static gems on it, only the cells whose static gem changed are drawn again.
+	// nullptr if the renderer has no render targets, then everything is drawn every frame
+	SDL_Texture* m_pBoardLayerTex;
+	int8_t m_layerCells[kBoardRows][kBoardCols];	// what the layer currently shows
+	bool m_bBoardLayerValid;
+
 	SDL_Texture* m_pGameOverTex;
 	SDL_Texture* m_pStartGameTex;
 
@@ -40,6 +56,12 @@ protected:
 
 	bool m_bStartGameTextVisible;
 	bool m_bGameOverTextVisible;
+	bool m_bProfilerOverlayVisible;
+
+	void	createBoardLayer();
+	void	updateBoardLayer(const BoardSnapshot& snapshot);
+	void	addStaticGems(const BoardSnapshot& snapshot);
+	bool	gemsFitInTiles() const;
 
 public:
 	GraphicsMgr::GraphicsMgr(const char* title, 
@@ -52,21 +74,31 @@ public:
 	~GraphicsMgr();
 
 	SDL_Renderer*	getRenderer()		{ return m_pRenderer; }
+	// false if the driver ignored the vsync request, presents then need another limiter
+	bool			hasVsync() const;
+	SpriteBatch&	getGemBatch()		{ return m_gemBatch; }
 	void			renderTexture(SDL_Texture* tex, int x, int y, int w, int h);
 	void			renderTexture(SDL_Texture* tex, int x, int y);
 	SDL_Texture*	renderText(const char* message, EFontType, SDL_Color color);
 	
 	void	setAssetMgr(AssetMgr* assetMgr) { m_pAssetMgr = assetMgr; }
 	void	setBoard(Board* board)			{ m_pBoard = board; }
-	void	render();
-	void	update(float dt_ms);
+	// alpha is passed to Board::render to place the moving gems between the last two updates
+	void	render(const BoardSnapshot& snapshot, float alpha);
+	void	update(const BoardSnapshot& snapshot);
+	// drawn while AssetMgr streams the assets in, progress goes from 0 to 1
+	void	renderLoadingScreen(float progress);
+
+	// the render targets were lost (SDL_RENDER_TARGETS_RESET), the layer is drawn again from scratch
+	void	invalidateBoardLayer()		{ m_bBoardLayerValid = false; }
 
 	void	setDebugDraw(bool value)	{ m_bDebugDraw = value; }
 	bool	getDebugDraw() const		{ return m_bDebugDraw; }
+
+	void	setProfilerOverlayVisible(bool value)	{ m_bProfilerOverlayVisible = value; }
+	bool	isProfilerOverlayVisible() const		{ return m_bProfilerOverlayVisible; }
 	
 	void	generateTextTextures();
-	void	setStartGameTextVisible(bool visible) { m_bStartGameTextVisible = visible; }
-	void	setGameOverTextVisible(bool visible) { m_bGameOverTextVisible = visible; }
 
 };
 #endif//GRAPHICS_MGR_H
@@ -0,0 +1,116 @@
+#include "HeadlessDriver.h"
+#include "Board.h"
+#include "GameSession.h"
+#include "Common.h"
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace Utils;
+
+HeadlessDriver::HeadlessDriver(int numGemTypes, uint64_t seed, float dt_ms, int framesPerMove) :
+	m_inputRandom(seed),
+	m_seed(seed),
+	m_framesPerMove(framesPerMove),
+	m_framesSimulated(0),
+	m_gamesPlayed(0),
+	m_totalScore(0),
+	m_elapsed_s(0.0)
+{
+	assert(framesPerMove > 0);
+	m_pBoard.reset(new Board(	numGemTypes,
+								kDefaultGemW,
+								kDefaultGemH,
+								kDefaultBoardBoundsXMin,
+								kDefaultBoardBoundsYMin,
+								kDefaultBoardW,
+								kDefaultBoardH,
+								/*pAssetMgr =*/nullptr,
+								/*pGfxMgr =*/nullptr));
+	m_pSession.reset(new GameSession(*m_pBoard, m_seed, dt_ms));
+}
+
+HeadlessDriver::~HeadlessDriver()
+{
+}
+
+void HeadlessDriver::setRecorder(ReplayRecorder* recorder)
+{
+	m_pSession->setRecorder(recorder);
+}
+
+void HeadlessDriver::finishRecording()
+{
+	m_pSession->finishRecording();
+}
+
+void HeadlessDriver::restartGame()
+{
+	m_totalScore += m_pBoard->getScore();
+	++m_gamesPlayed;
+
+	//every game gets its own seed, derived from the driver seed
+	InputEvent restart(InputEvent::EIT_RESTART_GAME);
+	restart.seed = m_seed + m_gamesPlayed;
+	m_pSession->handleInput(restart);
+}
+
+void HeadlessDriver::scriptInput(long long frame)
+{
+	if (frame % m_framesPerMove != 0)
+		return;
+
+	//click a random gem and then one of its neighbours, the same way a player would
+	int row = m_inputRandom.nextInt(kBoardRows);
+	int col = m_inputRandom.nextInt(kBoardCols);
+	int dir = m_inputRandom.nextInt(4);
+
+	int otherRow = row + (dir == 0 ? -1 : (dir == 1 ? 1 : 0));
+	int otherCol = col + (dir == 2 ? -1 : (dir == 3 ? 1 : 0));
+	if (otherRow < 0 || otherRow >= kBoardRows || otherCol < 0 || otherCol >= kBoardCols)
+		return;
+
+	Point first = m_pBoard->getTileCenter(row, col);
+	Point second = m_pBoard->getTileCenter(otherRow, otherCol);
+	m_pSession->handleInput(InputEvent(InputEvent::EIT_MOUSE_DOWN, first.x, first.y));
+	m_pSession->handleInput(InputEvent(InputEvent::EIT_MOUSE_UP, first.x, first.y));
+	m_pSession->handleInput(InputEvent(InputEvent::EIT_MOUSE_DOWN, second.x, second.y));
+	m_pSession->handleInput(InputEvent(InputEvent::EIT_MOUSE_UP, second.x, second.y));
+}
+
+void HeadlessDriver::run(long long numFrames)
+{
+	auto startTime = chrono::high_resolution_clock::now();
+
+	if (m_pSession->getGameState() == EGS_WaitingToStartGame)
+	{
+		m_pSession->handleInput(InputEvent(InputEvent::EIT_START_GAME));
+	}
+
+	for (long long frame = 0; frame < numFrames; ++frame)
+	{
+		scriptInput(m_framesSimulated);
+		m_pSession->step();
+		++m_framesSimulated;
+
+		if (m_pSession->getGameState() == EGS_GameOver)
+		{
+			restartGame();
+		}
+	}
+
+	auto endTime = chrono::high_resolution_clock::now();
+	m_elapsed_s += chrono::duration<double>(endTime - startTime).count();
+}
+
+void HeadlessDriver::printStats() const
+{
+	double framesPerSecond = m_elapsed_s > 0.0 ? m_framesSimulated / m_elapsed_s : 0.0;
+	double nsPerFrame = m_framesSimulated > 0 ? (m_elapsed_s * 1e9) / m_framesSimulated : 0.0;
+
+	cout << "headless: seed " << m_seed << endl;
+	cout << "headless: " << m_framesSimulated << " frames in " << m_elapsed_s << " s" << endl;
+	cout << "headless: " << framesPerSecond << " frames/s, " << nsPerFrame << " ns/frame" << endl;
+	cout << "headless: " << m_gamesPlayed << " games finished, total score " << m_totalScore + m_pBoard->getScore() << endl;
+}
@@ -0,0 +1,54 @@
+#ifndef HEADLESS_DRIVER_H
+#define HEADLESS_DRIVER_H
+
+#include <memory>
+
+#include "Random.h"
+#include "BoardFwd.h"
+
+class GameSession;
+class ReplayRecorder;
+
+// Steps a Board without a window, audio or renderer at a fixed dt.
+// Input is scripted from a seeded generator so that two runs with the same seed
+// simulate exactly the same frames, which makes it usable for profiling on CI boxes.
+// The input goes through a GameSession, so a run can also be recorded as a replay.
+class HeadlessDriver
+{
+private:
+	std::unique_ptr<Board> m_pBoard;
+	std::unique_ptr<GameSession> m_pSession;
+	Random m_inputRandom;
+
+	uint64_t m_seed;
+	int m_framesPerMove;
+
+	long long m_framesSimulated;
+	int m_gamesPlayed;
+	long long m_totalScore;
+	double m_elapsed_s;
+
+	void scriptInput(long long frame);
+	void restartGame();
+
+public:
+	static const int kDefaultFramesPerMove = 20;
+
+	HeadlessDriver(int numGemTypes, uint64_t seed, float dt_ms, int framesPerMove = kDefaultFramesPerMove);
+	~HeadlessDriver();
+
+	// must be called before the first run, the recording is finished by finishRecording
+	void setRecorder(ReplayRecorder* recorder);
+	void finishRecording();
+
+	// Simulates numFrames frames of dt_ms each, restarting the game whenever the timer runs out
+	void run(long long numFrames);
+	void printStats() const;
+
+	Board&		getBoard()				{ return *m_pBoard; }
+	long long	getFramesSimulated() const	{ return m_framesSimulated; }
+	int			getGamesPlayed() const		{ return m_gamesPlayed; }
+	long long	getTotalScore() const		{ return m_totalScore; }
+	double		getElapsedSeconds() const	{ return m_elapsed_s; }
+};
+#endif//HEADLESS_DRIVER_H
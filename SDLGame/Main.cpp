@@ -2,6 +2,17 @@
 #include "Common.h"
 #include "AssetMgr.h"
 #include "GraphicsMgr.h"
+#include "HeadlessDriver.h"
+#include "BatchSimulator.h"
+#include "BoardBenchmark.h"
+#include "Profiler.h"
+#include "GameSimulation.h"
+#include "FramePacer.h"
+#include "Replay.h"
+#include "AssetPack.h"
+#include "BoardPool.h"
+#include "StressDriver.h"
+#include "MegaBoard.h"
 
 //@TODO: put all this in a precompiled header
 #include <SDL_image.h>
@@ -10,6 +21,11 @@
 
 #include <vector>
 #include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include <assert.h>
 
@@ -19,16 +35,322 @@ const int SCREEN_WIDTH  = 755;
 const int SCREEN_HEIGHT = 600;
 namespace
 {
-	enum EGameState
-	{ 
-		EGS_WaitingToStartGame = 0,
-		EGS_GameRunning,
-		EGS_GameOver
-	};
+	// Number of gem sprites loaded by AssetMgr, used when running without assets
+	const int kHeadlessNumGemTypes = 5;
+	const long long kHeadlessDefaultFrames = 1000000;
+	const float kHeadlessFrameTime_ms = 1000.f / 60.f;
+
+	const long long kStressDefaultFrames = 100000;
+	// the larger boards get a swap every frame, there are that many more gems to move
+	const int kStressFramesPerMove = 1;
+
+	const int kMegaDefaultSize = 4096;
+	const int kMegaDefaultSteps = 20;
+
+	// the board is always simulated in steps of kSimulationStep_ms, whatever the frame rate
+	const double kSimulationStep_ms = 1000.0 / 60.0;
+	// past this many steps in one frame the game slows down instead of stalling to catch up
+	const int kMaxSimulationStepsPerFrame = 6;
+
+	// once nothing moves, the main loop only wakes up this often to look at the simulation
+	const int kIdleWait_ms = 100;
+	// frames still presented after the last change or input
+	const int kActiveFrames = 30;
+	// frame limit used when the renderer couldn't get vsync
+	const int kDefaultMaxFps = 60;
+
+	const int kTraceCaptureFrames = 300;
+	const char* const kTraceFile = "trace.json";
+	const char* const kDefaultReplayFile = "last_session.dmr";
+
+	// usage: SDLGame -headless [numFrames] [seed] [replayFile]
+	int runHeadless(int argc, char** argv)
+	{
+		long long numFrames = argc > 2 ? atoll(argv[2]) : kHeadlessDefaultFrames;
+		uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+		const char* replayFile = argc > 4 ? argv[4] : nullptr;
+
+		HeadlessDriver driver(kHeadlessNumGemTypes, seed, kHeadlessFrameTime_ms);
+		ReplayRecorder recorder;
+		if (replayFile)
+		{
+			driver.setRecorder(&recorder);
+		}
+		driver.run(numFrames);
+		driver.printStats();
+
+		if (replayFile)
+		{
+			driver.finishRecording();
+			if (!recorder.save(replayFile))
+			{
+				cout << "Failed to write the replay to " << replayFile << endl;
+				return 1;
+			}
+			cout << "headless: recorded " << recorder.getData().size() << " bytes to " << replayFile << endl;
+		}
+		return 0;
+	}
+
+	// usage: SDLGame -batch [numBoards] [numSteps] [numThreads] [seed]
+	// numThreads 0 uses all the cores
+	int runBatch(int argc, char** argv)
+	{
+		int numBoards = argc > 2 ? atoi(argv[2]) : 4096;
+		int numSteps = argc > 3 ? atoi(argv[3]) : 1000;
+		int numThreads = argc > 4 ? atoi(argv[4]) : 0;
+		uint64_t seed = argc > 5 ? strtoull(argv[5], nullptr, 10) : 0;
+
+		BatchSimConfig config;
+		config.numGemTypes = kHeadlessNumGemTypes;
+
+		BatchSimulator simulator(numBoards, config, seed);
+		simulator.run(numSteps, numThreads);
+		simulator.printStats();
+		return 0;
+	}
+
+	// usage: SDLGame -replay [-repeat numRepeats] file [file ...]
+	// plays the recordings back without a window as fast as possible and checks their checksums
+	int runReplays(int argc, char** argv)
+	{
+		int firstFile = 2;
+		int numRepeats = 1;
+		if (argc > 3 && strcmp(argv[2], "-repeat") == 0)
+		{
+			numRepeats = atoi(argv[3]);
+			firstFile = 4;
+		}
+
+		vector<ReplayPlayer> players(max(argc - firstFile, 0));
+		for (size_t i = 0; i < players.size(); ++i)
+		{
+			if (!players[i].load(argv[firstFile + i]))
+			{
+				cout << "Failed to read the replay " << argv[firstFile + i] << endl;
+				return 1;
+			}
+		}
+
+		int numFailed = 0;
+		long long numTicks = 0;
+		auto startTime = chrono::high_resolution_clock::now();
+		for (int repeat = 0; repeat < numRepeats; ++repeat)
+		{
+			for (size_t i = 0; i < players.size(); ++i)
+			{
+				ReplayPlayer::Result result = players[i].play();
+				numTicks += result.numTicks;
+				if (!result.valid || !result.matched)
+				{
+					++numFailed;
+				}
+				if (repeat == 0)
+				{
+					cout << "replay: " << argv[firstFile + i] << ": ";
+					if (!result.valid)
+						cout << "invalid file" << endl;
+					else if (!result.matched)
+						cout << "diverged at tick " << result.firstMismatchTick << endl;
+					else
+						cout << result.numTicks << " ticks, score " << result.score << ", ok" << endl;
+				}
+			}
+		}
+		double elapsed_s = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+		long long numPlayed = static_cast<long long>(players.size()) * numRepeats;
+
+		cout << "replay: " << numPlayed << " sessions, " << numTicks << " ticks in " << elapsed_s << " s" << endl;
+		if (elapsed_s > 0.0)
+		{
+			cout << "replay: " << numPlayed / elapsed_s << " sessions/s, " << numTicks / elapsed_s << " ticks/s" << endl;
+		}
+		return numFailed > 0 ? 1 : 0;
+	}
+
+	// usage: SDLGame -pack [dataDir] [packFile]
+	// bundles the whole data directory, decoded, into the pack AssetMgr maps at startup
+	int runPacker(int argc, char** argv)
+	{
+		string dataDir = argc > 2 ? argv[2] : AssetMgr::kDataDir;
+		const char* packFile = argc > 3 ? argv[3] : AssetMgr::kPackFile;
+
+		//the sounds are converted to the format of the audio device the game opens
+		if (SDL_Init(SDL_INIT_AUDIO) == -1 || !AssetMgr::openAudioDevice())
+		{
+			Utils::logSDLError("SDL_Init");
+			return 1;
+		}
+		int flags = IMG_INIT_JPG | IMG_INIT_PNG;
+		if ((IMG_Init(flags) & flags) != flags)
+		{
+			Utils::logSDLError("IMG_Init");
+			return 1;
+		}
+
+		auto startTime = chrono::high_resolution_clock::now();
+		AssetPackWriter writer;
+		bool written = writer.addDirectory(dataDir) && writer.write(packFile);
+		double elapsed_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
+		IMG_Quit();
+		Mix_CloseAudio();
+		SDL_Quit();
+		if (!written)
+		{
+			cout << "pack: failed to write " << packFile << endl;
+			return 1;
+		}
+		cout << "pack: " << writer.getNumEntries() << " files, " << writer.getDataSize() << " bytes to " << packFile << " in " << elapsed_ms << " ms" << endl;
+		return 0;
+	}
+
+	template <class BoardT>
+	int runStressBoard(long long numFrames, uint64_t seed)
+	{
+		StressDriver<BoardT> driver(kHeadlessNumGemTypes, seed, kHeadlessFrameTime_ms, kStressFramesPerMove);
+		driver.run(numFrames);
+		driver.printStats();
+		return 0;
+	}
+
+	// usage: SDLGame -stress [size] [numFrames] [seed]
+	// plays a size x size board headless, size is one of the instantiated ones: 16 or 64
+	int runStress(int argc, char** argv)
+	{
+		int size = argc > 2 ? atoi(argv[2]) : LargeBoard::kRows;
+		long long numFrames = argc > 3 ? atoll(argv[3]) : kStressDefaultFrames;
+		uint64_t seed = argc > 4 ? strtoull(argv[4], nullptr, 10) : 0;
+
+		if (size == LargeBoard::kRows)
+			return runStressBoard<LargeBoard>(numFrames, seed);
+		if (size == HugeBoard::kRows)
+			return runStressBoard<HugeBoard>(numFrames, seed);
+		cout << "stress: no " << size << "x" << size << " board, use " << LargeBoard::kRows << " or " << HugeBoard::kRows << endl;
+		return 1;
+	}
+
+	template <int SIZE>
+	int runMegaBoard(int numSteps, int maxThreads, uint64_t seed)
+	{
+		typedef MegaBoard<SIZE, SIZE> BoardT;
+		BoardT board(kHeadlessNumGemTypes, seed);
+		cout << "mega: " << SIZE << "x" << SIZE << " board, " << BoardT::kNumTiles << " tiles of " << BoardT::kTileRows << "x" << BoardT::kTileCols 
+			<< ", " << numSteps << " steps" << endl;
+
+		//the same steps on 1, 2, 4... threads, they must all end on the same board
+		double singleThreadCellsPerSecond = 0.0;
+		for (int numThreads = 1; ; numThreads = min(2 * numThreads, maxThreads))
+		{
+			board.reset(seed, numThreads);
+			double match_s = 0.0;
+			double collapse_s = 0.0;
+			for (int step = 0; step < numSteps; ++step)
+			{
+				auto startTime = chrono::high_resolution_clock::now();
+				board.findMatches(numThreads);
+				auto matchedTime = chrono::high_resolution_clock::now();
+				board.collapse(numThreads);
+				auto endTime = chrono::high_resolution_clock::now();
+				match_s += chrono::duration<double>(matchedTime - startTime).count();
+				collapse_s += chrono::duration<double>(endTime - matchedTime).count();
+			}
+
+			double cellsPerSecond = static_cast<double>(SIZE) * SIZE * numSteps / (match_s + collapse_s);
+			if (numThreads == 1)
+			{
+				singleThreadCellsPerSecond = cellsPerSecond;
+			}
+			cout << "mega: " << numThreads << " threads: match " << match_s * 1000.0 / numSteps << " ms/step, collapse " 
+				<< collapse_s * 1000.0 / numSteps << " ms/step, " << cellsPerSecond * 1e-6 << " Mcells/s, speedup " 
+				<< cellsPerSecond / singleThreadCellsPerSecond << ", cleared " << board.getNumCleared() << ", checksum " << board.computeChecksum() << endl;
+			if (numThreads == maxThreads)
+				break;
+		}
+		return 0;
+	}
+
+	// usage: SDLGame -mega [size] [numSteps] [maxThreads] [seed]
+	// times the cascade steps of a size x size MegaBoard on more and more threads, size is 1024 or 4096.
+	// maxThreads 0 goes up to one thread per core
+	int runMegaBoardBenchmark(int argc, char** argv)
+	{
+		int size = argc > 2 ? atoi(argv[2]) : kMegaDefaultSize;
+		int numSteps = argc > 3 ? atoi(argv[3]) : kMegaDefaultSteps;
+		int maxThreads = argc > 4 ? atoi(argv[4]) : 0;
+		uint64_t seed = argc > 5 ? strtoull(argv[5], nullptr, 10) : 0;
+		if (maxThreads <= 0)
+		{
+			maxThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+		}
+
+		if (size == 1024)
+			return runMegaBoard<1024>(numSteps, maxThreads, seed);
+		if (size == 4096)
+			return runMegaBoard<4096>(numSteps, maxThreads, seed);
+		cout << "mega: no " << size << "x" << size << " board, use 1024 or 4096" << endl;
+		return 1;
+	}
+
+	// usage: SDLGame -bench [numOps] [seed]
+	int runBenchmarks(int argc, char** argv)
+	{
+		long long numOps = argc > 2 ? atoll(argv[2]) : 200000;
+		uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+
+		BoardBenchmark benchmark(kHeadlessNumGemTypes, seed, numOps);
+		benchmark.run();
+		benchmark.printResults();
+		return 0;
+	}
 }
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "-headless") == 0)
+	{
+		//no window, no audio: only the board simulation runs
+		return runHeadless(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-batch") == 0)
+	{
+		return runBatch(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-replay") == 0)
+	{
+		return runReplays(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+	{
+		return runBenchmarks(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-stress") == 0)
+	{
+		return runStress(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-mega") == 0)
+	{
+		return runMegaBoardBenchmark(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "-pack") == 0)
+	{
+		return runPacker(argc, argv);
+	}
 
+	// usage: SDLGame [-record replayFile] [-maxfps fps]
+	// -maxfps limits the frame rate even with vsync, 0 never limits it
+	const char* replayFile = kDefaultReplayFile;
+	int maxFps = -1;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-record") == 0)
+		{
+			replayFile = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "-maxfps") == 0)
+		{
+			maxFps = atoi(argv[i + 1]);
+		}
+	}
 
 	if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS) == -1)
 	{
@@ -51,15 +373,33 @@ int main(int argc, char** argv)
 	AssetMgr assetMgr(gfxMgr.getRenderer());
 	gfxMgr.setAssetMgr(&assetMgr);
 
+	//the assets are decoded on worker threads, keep the window alive and show the progress meanwhile
+	{
+		SDL_Event e;
+		while (!assetMgr.update())
+		{
+			while (SDL_PollEvent(&e))
+			{
+				if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+				{
+					SDL_Quit();
+					return 0;
+				}
+			}
+			gfxMgr.renderLoadingScreen(assetMgr.getLoadProgress());
+		}
+		assetMgr.printLoadTimings();
+	}
+
 	unique_ptr<Board> pBoard;
 	{
 		 Board* boardPtr = new Board(	assetMgr.getNumGemTypes(),
-										/*gemW =*/35,
-										/*gemW =*/35,
-										/*boardBoundsXMin =*/315,
-										/*boardBoundsYMin =*/95,
-										/*boardW =*/360,
-										/*boardH =*/352,
+										kDefaultGemW,
+										kDefaultGemH,
+										kDefaultBoardBoundsXMin,
+										kDefaultBoardBoundsYMin,
+										kDefaultBoardW,
+										kDefaultBoardH,
 										&assetMgr,
 										&gfxMgr);
 		 
@@ -68,96 +408,137 @@ int main(int argc, char** argv)
 	gfxMgr.setBoard(pBoard.get());
 	gfxMgr.generateTextTextures();
 
+	//the next boards are generated in the background, a restart only copies one
+	BoardPool boardPool(assetMgr.getNumGemTypes(), SDL_GetPerformanceCounter());
+	pBoard->setBoardPool(&boardPool);
+
 	
 
 	//int iW, iH;
 	//SDL_QueryTexture(textImg, NULL, NULL, &iW, &iH);
 
 	assetMgr.playMusic();
-	EGameState gameState = EGS_WaitingToStartGame;
-	pBoard->setGameRunning(false);
-	gfxMgr.setStartGameTextVisible(true);
-	gfxMgr.setGameOverTextVisible(false);
 
-	uint32_t currentTime_ms = SDL_GetTicks();
+	Profiler& profiler = Profiler::instance();
+	profiler.setEnabled(true);
+
+	//the game rules and the board run on their own thread from here on, 
+	//this loop only forwards input and draws what the simulation published
+	GameSimulation simulation(*pBoard, boardPool.claimSeed(), kSimulationStep_ms, kMaxSimulationStepsPerFrame);
+	//every session is recorded, so a bug report can come with the exact game that led to it
+	ReplayRecorder recorder;
+	simulation.setRecorder(&recorder);
+	simulation.start();
 
 	bool quit = false;
 	SDL_Event e;
+	ProfileSummary simulationProfile;
+
+	FramePacer pacer(kIdleWait_ms, kActiveFrames);
+	if (maxFps < 0)
+	{
+		maxFps = gfxMgr.hasVsync() ? 0 : kDefaultMaxFps;
+	}
+	pacer.setMaxFps(maxFps);
 
 	while(!quit)
 	{
-		uint32_t newTime_ms = SDL_GetTicks();
-		float dt_ms = static_cast<float>(newTime_ms - currentTime_ms);
-		const float kMaxFrameTime = 100.f;
-		const float kMinFrameTime = 1.f; 
-		dt_ms = dt_ms < kMinFrameTime ? kMinFrameTime : dt_ms;
-		dt_ms = dt_ms > kMaxFrameTime ? kMaxFrameTime : dt_ms;
-		currentTime_ms = newTime_ms;
-		
-		while (SDL_PollEvent(&e))
+		profiler.beginFrame();
+		profiler.beginScope(EPS_EVENTS);
+		//with nothing to animate, sleep until an event arrives instead of spinning
+		bool hasEvent = pacer.isIdle() ? SDL_WaitEventTimeout(&e, pacer.getIdleWait_ms()) != 0 : SDL_PollEvent(&e) != 0;
+		for (; hasEvent; hasEvent = SDL_PollEvent(&e) != 0)
 		{
+			pacer.onActivity();
 			switch (e.type)
 			{
 				//If user closes the window
 				case SDL_QUIT:
 					quit = true; 
 					break;
+				//the cached board layer lived in a render target
+				case SDL_RENDER_TARGETS_RESET:
+					gfxMgr.invalidateBoardLayer();
+					break;
 				//If user presses any key
 				case SDL_KEYDOWN:
 					switch (e.key.keysym.sym)
 					{
 						case SDLK_s:
-							if (gameState == EGS_WaitingToStartGame)
-							{
-								gfxMgr.setStartGameTextVisible(false);
-								pBoard->setGameRunning(true);
-								gameState = EGS_GameRunning;
-							}
+							simulation.pushInput(InputEvent(InputEvent::EIT_START_GAME));
 							break;
 						case SDLK_r:
-							gfxMgr.setStartGameTextVisible(false);
-							gfxMgr.setGameOverTextVisible(false);
-							pBoard->init();
-							pBoard->setGameRunning(true);
-							gameState = EGS_GameRunning;
+						{
+							InputEvent restart(InputEvent::EIT_RESTART_GAME);
+							restart.seed = boardPool.claimSeed();
+							simulation.pushInput(restart);
 							break;
+						}
 						case SDLK_ESCAPE:
 							quit = true;
 							break;
 						case SDLK_0:
 							gfxMgr.setDebugDraw(!gfxMgr.getDebugDraw());
 							break;
+						case SDLK_p:
+							gfxMgr.setProfilerOverlayVisible(!gfxMgr.isProfilerOverlayVisible());
+							break;
+						case SDLK_t:
+							profiler.startTraceCapture(kTraceCaptureFrames, kTraceFile);
+							break;
+						case SDLK_h:
+							simulation.pushInput(InputEvent(InputEvent::EIT_SHOW_HINT));
+							break;
 					}
 					break;
 				//If user clicks the mouse
 				case SDL_MOUSEBUTTONDOWN:
 				{
-					if (gameState == EGS_GameRunning)
-					{
-						pBoard->mouseEvent(e.button.x, e.button.y, true);
-					}
+					simulation.pushInput(InputEvent(InputEvent::EIT_MOUSE_DOWN, e.button.x, e.button.y));
 					break;
 				}
 				case SDL_MOUSEBUTTONUP:
 				{
-					if (gameState == EGS_GameRunning)
-					{
-						pBoard->mouseEvent(e.button.x, e.button.y, false);
-					}
+					simulation.pushInput(InputEvent(InputEvent::EIT_MOUSE_UP, e.button.x, e.button.y));
 					break;
 				}
 			}
 		}
-		gfxMgr.update(dt_ms);
-		pBoard->update(dt_ms);
-		
-		if (pBoard->getSecondsLeft() == 0)
+		profiler.endScope(EPS_EVENTS);
+
+		profiler.beginScope(EPS_GFX_UPDATE);
+		const BoardSnapshot& snapshot = simulation.acquireSnapshot();
+		if (simulation.acquireProfileSummary(simulationProfile))
+		{
+			profiler.setRemoteSummary(simulationProfile);
+		}
+		//the board scopes go in the trace too, they are only kept while a capture runs
+		ProfileTraceEvent traceEvent;
+		while (simulation.popTraceEvent(traceEvent))
 		{
-			pBoard->setGameRunning(false);
-			gameState = EGS_GameOver;
-			gfxMgr.setGameOverTextVisible(true);
+			profiler.recordRemoteScope(traceEvent, GameSimulation::kTraceThreadId);
 		}
-		gfxMgr.render();
+		//the overlay and a trace capture need fresh frames even when the board is still
+		bool present = pacer.beginFrame(snapshot.animating || gfxMgr.isProfilerOverlayVisible() || profiler.isCapturingTrace());
+		if (present)
+		{
+			gfxMgr.update(snapshot);
+		}
+		profiler.endScope(EPS_GFX_UPDATE);
+
+		if (present)
+		{
+			gfxMgr.render(snapshot, FrameClock::computeAlpha(snapshot.stateCount, snapshot.step_s));
+		}
+		profiler.endFrame();
+		pacer.endFrame(present);
+	}
+	cout << "frames: " << pacer.getNumPresented() << " presented, " << pacer.getNumSkipped() << " skipped while idle" << endl;
+
+	simulation.stop();
+	if (!recorder.save(replayFile))
+	{
+		cout << "Failed to write the replay to " << replayFile << endl;
 	}
 
 	SDL_Quit();
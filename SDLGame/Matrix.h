@@ -21,5 +21,8 @@ public:
 		assert(row < ROWS && col < COLS);
 		return matrix[row][col];
 	}
+
+	// the elements row after row
+	const T* data() const { return &matrix[0][0]; }
 };
 #endif//MATRIX_IMPL_H
@@ -0,0 +1,299 @@
+#ifndef MEGA_BOARD_H
+#define MEGA_BOARD_H
+
+#include "Matrix.h"
+#include "Random.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include <assert.h>
+
+// Match and gravity rules of the game on boards of thousands of cells per side, for the mega-board modes
+// and stress runs, without any animation: a step finds every run of 3+ at once, clears them all, lets the
+// gems above fall and refills the columns from the top.
+// Runs are found tile by tile, each tile small enough to stay in cache and handed to whichever thread is free.
+// A tile reads up to two cells past its borders (its halo) but only writes its own cells, so tiles never
+// need to synchronize. Gravity is resolved by strips of whole columns, one strip per task.
+// The result of a step doesn't depend on the number of threads: the refills of a strip come from a generator
+// seeded by the board seed, the step and the strip.
+template <int ROWS, int COLS>
+class MegaBoard
+{
+public:
+	static const int kTileRows = 64;
+	static const int kTileCols = 256;
+	static const int kNumTileRows = (ROWS + kTileRows - 1) / kTileRows;
+	static const int kNumTileCols = (COLS + kTileCols - 1) / kTileCols;
+	static const int kNumTiles = kNumTileRows * kNumTileCols;
+	// gravity is resolved by strips of this many columns, a cache line of each row
+	static const int kStripCols = 64;
+	static const int kNumStrips = (COLS + kStripCols - 1) / kStripCols;
+
+private:
+	static_assert(ROWS >= 3 && COLS >= 3, "The board is too small to hold a run of 3 gems.");
+
+	typedef Matrix<int8_t, ROWS, COLS> CellMatrix;
+	typedef Matrix<uint8_t, ROWS, COLS> FlagMatrix;
+	// the board transposed, a column per row. The rows are padded by a cache line so that
+	// the same cell of neighbouring columns doesn't always fall in the same cache set
+	static const int kColumnPadding = 64;
+	typedef Matrix<int8_t, COLS, ROWS + kColumnPadding> ColumnMatrix;
+
+	// a few MB each, they don't belong on the stack
+	std::unique_ptr<CellMatrix> m_pCells;
+	std::unique_ptr<FlagMatrix> m_pMatched;	// 1 for the cells of a run, written by findMatches
+	std::unique_ptr<ColumnMatrix> m_pColumns;	// scratch of collapse
+	std::vector<int> m_tileMatches;			// matched cells per tile
+	std::vector<int> m_stripRefills;		// cells refilled per column strip
+
+	int m_numGemTypes;
+	uint64_t m_seed;
+	long long m_numSteps;
+	long long m_numCleared;
+
+	MegaBoard(const MegaBoard&);
+	MegaBoard& operator=(const MegaBoard&);
+
+	// runs fn(item) for every item in [0, numItems) on numThreads threads, the items are handed out one at a time
+	template <class Fn>
+	static void parallelFor(int numItems, int numThreads, const Fn& fn)
+	{
+		std::atomic<int> nextItem(0);
+		auto work = [&]()
+		{
+			for (int item = nextItem++; item < numItems; item = nextItem++)
+			{
+				fn(item);
+			}
+		};
+
+		numThreads = std::min(numThreads, numItems);
+		if (numThreads <= 1)
+		{
+			work();
+			return;
+		}
+		std::vector<std::thread> threads;
+		for (int i = 1; i < numThreads; ++i)
+		{
+			threads.push_back(std::thread(work));
+		}
+		work();
+		for (auto& worker : threads)
+		{
+			worker.join();
+		}
+	}
+
+	// the generator a strip draws its new gems from at the current step
+	Random stripRandom(int strip) const
+	{
+		return Random(m_seed + static_cast<uint64_t>(m_numSteps) * kNumStrips + strip);
+	}
+
+	// starts[i] = 1 when cells i, i + 1 and i + 2 have the same color
+	static void findRunStarts(const int8_t* a, const int8_t* b, const int8_t* c, int count, uint8_t* starts)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			starts[i] = static_cast<uint8_t>((a[i] == b[i]) & (b[i] == c[i]));
+		}
+	}
+
+	void findTileMatches(int tile)
+	{
+		CellMatrix& cells = *m_pCells;
+		FlagMatrix& matched = *m_pMatched;
+
+		int rowBegin = (tile / kNumTileCols) * kTileRows;
+		int rowEnd = std::min(rowBegin + kTileRows, ROWS);
+		int colBegin = (tile % kNumTileCols) * kTileCols;
+		int colEnd = std::min(colBegin + kTileCols, COLS);
+		int width = colEnd - colBegin;
+
+		// the halo: a cell is in a horizontal run if one starts at most 2 cells before it, the same vertically
+		uint8_t hStarts[kTileCols + 2];
+		uint8_t vStarts[3][kTileCols];	// ring of the last three rows of vertical starts
+
+		int matches = 0;
+		for (int row = rowBegin - 2; row < rowEnd; ++row)
+		{
+			uint8_t* vRow = vStarts[(row - rowBegin + 3) % 3];
+			if (row >= 0 && row + 2 < ROWS)
+			{
+				findRunStarts(&cells(row, colBegin), &cells(row + 1, colBegin), &cells(row + 2, colBegin), width, vRow);
+			}
+			else
+			{
+				std::fill(vRow, vRow + width, static_cast<uint8_t>(0));
+			}
+			if (row < rowBegin)
+				continue;
+
+			// hStarts[i] is the start at column colBegin - 2 + i, the ones past either edge of the board are 0
+			int first = std::max(colBegin - 2, 0);
+			int last = std::min(colEnd, COLS - 2);
+			std::fill(hStarts, hStarts + width + 2, static_cast<uint8_t>(0));
+			const int8_t* rowCells = &cells(row, 0);
+			findRunStarts(rowCells + first, rowCells + first + 1, rowCells + first + 2, last - first, hStarts + first - (colBegin - 2));
+
+			const uint8_t* v0 = vStarts[(row - rowBegin + 1) % 3];
+			const uint8_t* v1 = vStarts[(row - rowBegin + 2) % 3];
+			uint8_t* rowMatched = &matched(row, colBegin);
+			for (int i = 0; i < width; ++i)
+			{
+				uint8_t m = hStarts[i] | hStarts[i + 1] | hStarts[i + 2] | v0[i] | v1[i] | vRow[i];
+				rowMatched[i] = m;
+				matches += m;
+			}
+		}
+		m_tileMatches[tile] = matches;
+	}
+
+	void collapseStrip(int strip)
+	{
+		CellMatrix& cells = *m_pCells;
+		FlagMatrix& matched = *m_pMatched;
+		ColumnMatrix& columns = *m_pColumns;
+
+		int colBegin = strip * kStripCols;
+		int width = std::min(colBegin + kStripCols, COLS) - colBegin;
+
+		// The gems that stay are first packed from the bottom of their column into the columns matrix, walking
+		// up the rows. Moving them down in place would write rows far below the ones being read, which on
+		// a wide board all map to the same few cache sets
+		int numKept[kStripCols];
+		int8_t* kept[kStripCols];
+		for (int i = 0; i < width; ++i)
+		{
+			numKept[i] = 0;
+			kept[i] = &columns(colBegin + i, 0);
+		}
+		for (int row = ROWS - 1; row >= 0; --row)
+		{
+			const int8_t* src = &cells(row, colBegin);
+			const uint8_t* cleared = &matched(row, colBegin);
+			for (int i = 0; i < width; ++i)
+			{
+				kept[i][numKept[i]] = src[i];
+				numKept[i] += 1 - cleared[i];
+			}
+		}
+
+		// then written back row by row, the top of each column filled with new gems
+		Random random = stripRandom(strip);
+		int refills = 0;
+		for (int row = ROWS - 1; row >= 0; --row)
+		{
+			int depth = ROWS - 1 - row;
+			int8_t* dst = &cells(row, colBegin);
+			for (int i = 0; i < width; ++i)
+			{
+				if (depth < numKept[i])
+				{
+					dst[i] = kept[i][depth];
+				}
+				else
+				{
+					dst[i] = static_cast<int8_t>(random.nextInt(m_numGemTypes));
+					++refills;
+				}
+			}
+		}
+		m_stripRefills[strip] = refills;
+	}
+
+public:
+	MegaBoard(int numGemTypes, uint64_t seed) :
+		m_pCells(new CellMatrix),
+		m_pMatched(new FlagMatrix),
+		m_pColumns(new ColumnMatrix),
+		m_tileMatches(kNumTiles, 0),
+		m_stripRefills(kNumStrips, 0),
+		m_numGemTypes(numGemTypes)
+	{
+		assert(numGemTypes >= 2 && numGemTypes <= 127);
+		reset(seed, 1);
+	}
+
+	// fills the board with random gems, runs included
+	void reset(uint64_t seed, int numThreads)
+	{
+		m_seed = seed;
+		m_numSteps = 0;
+		m_numCleared = 0;
+		CellMatrix& cells = *m_pCells;
+		parallelFor(kNumStrips, numThreads, [&](int strip)
+		{
+			Random random = stripRandom(strip);
+			int colEnd = std::min((strip + 1) * kStripCols, COLS);
+			for (int row = 0; row < ROWS; ++row)
+			{
+				for (int col = strip * kStripCols; col < colEnd; ++col)
+				{
+					cells(row, col) = static_cast<int8_t>(random.nextInt(m_numGemTypes));
+				}
+			}
+		});
+	}
+
+	// flags every cell that is part of a run of 3+, returns how many there are
+	int findMatches(int numThreads)
+	{
+		parallelFor(kNumTiles, numThreads, [this](int tile) { findTileMatches(tile); });
+
+		int matches = 0;
+		for (int tile = 0; tile < kNumTiles; ++tile)
+		{
+			matches += m_tileMatches[tile];
+		}
+		return matches;
+	}
+
+	// clears the cells flagged by the last findMatches, makes the gems above them fall and refills the columns.
+	// Returns the number of new gems, which is the number of cells cleared
+	int collapse(int numThreads)
+	{
+		parallelFor(kNumStrips, numThreads, [this](int strip) { collapseStrip(strip); });
+		++m_numSteps;
+
+		int refills = 0;
+		for (int strip = 0; strip < kNumStrips; ++strip)
+		{
+			refills += m_stripRefills[strip];
+		}
+		m_numCleared += refills;
+		return refills;
+	}
+
+	// one cascade step, returns the number of cleared cells, 0 once the board has no run left
+	int step(int numThreads)
+	{
+		return findMatches(numThreads) > 0 ? collapse(numThreads) : 0;
+	}
+
+	int8_t getCell(int row, int col) const { return (*m_pCells)(row, col); }
+	long long getNumSteps() const { return m_numSteps; }
+	long long getNumCleared() const { return m_numCleared; }
+
+	// FNV-1a of the cells, the same seed and steps give the same checksum on any number of threads
+	uint32_t computeChecksum() const
+	{
+		const CellMatrix& cells = *m_pCells;
+		uint32_t hash = 2166136261u;
+		for (int row = 0; row < ROWS; ++row)
+		{
+			for (int col = 0; col < COLS; ++col)
+			{
+				hash ^= static_cast<uint8_t>(cells(row, col));
+				hash *= 16777619u;
+			}
+		}
+		return hash;
+	}
+};
+#endif//MEGA_BOARD_H
@@ -0,0 +1,86 @@
+#ifndef MOVE_INDEX_H
+#define MOVE_INDEX_H
+
+#include "BitBoard.h"
+
+// Keeps, for every static gem, whether swapping it with its right or bottom neighbour makes a match.
+// Cells are invalidated as they change and the next refresh evaluates every swap again, so a board
+// that doesn't change costs nothing. The whole board is recomputed rather than only the swaps near the
+// changed cells: it is a few dozen operations per color either way, masking them to a region saves nothing.
+template <int ROWS, int COLS, int MAX_GEM_TYPES = 8>
+class MoveIndex
+{
+public:
+	typedef BitBoard<ROWS, COLS, MAX_GEM_TYPES> Bits;
+	typedef typename Bits::Mask Mask;
+
+private:
+	Mask m_validRight;	// bit (row, col) set: swapping (row, col) with (row, col + 1) makes a match
+	Mask m_validDown;	// bit (row, col) set: swapping (row, col) with (row + 1, col) makes a match
+	Mask m_dirty;
+
+	// For each cell, whether its neighbours at the given offset hold a gem of the mask
+	static Mask left(Mask gems, int n)	{ Mask m = gems; for (int i = 0; i < n; ++i) m = (m << 1) & ~Bits::kFirstColumn; return m; }
+	static Mask right(Mask gems, int n)	{ Mask m = gems; for (int i = 0; i < n; ++i) m = (m >> 1) & ~Bits::kLastColumn; return m; }
+	static Mask up(Mask gems, int n)	{ return (gems << (n * COLS)) & Bits::kAllCells; }
+	static Mask down(Mask gems, int n)	{ return gems >> (n * COLS); }
+
+public:
+	// Evaluates every swap of the board at once, one color at a time: a swap is valid when a gem of that color
+	// moves next to two others of the same color, without counting the cell it left
+	static void findValidSwaps(const Mask* gemMasks, Mask staticGems, int numGemTypes, Mask& validRight, Mask& validDown)
+	{
+		validRight = 0;
+		validDown = 0;
+
+		for (int color = 0; color < numGemTypes; ++color)
+		{
+			Mask gems = gemMasks[color];
+			Mask left1 = left(gems, 1);
+			Mask right1 = right(gems, 1);
+			Mask up1 = up(gems, 1);
+			Mask down1 = down(gems, 1);
+
+			Mask runLeft	= left1 & left(gems, 2);
+			Mask runRight	= right1 & right(gems, 2);
+			Mask runUp		= up1 & up(gems, 2);
+			Mask runDown	= down1 & down(gems, 2);
+			Mask runMiddleH	= left1 & right1;
+			Mask runMiddleV	= up1 & down1;
+
+			// cells of another color that would become part of a run if they received a gem of this color
+			Mask receivers = staticGems & ~gems;
+
+			// the gem of this color comes from the right neighbour / leaves towards it
+			validRight |= right1 & receivers & (runLeft | runUp | runMiddleV | runDown);
+			validRight |= gems & ~Bits::kLastColumn & (((receivers & (runRight | runUp | runMiddleV | runDown)) >> 1));
+
+			// the gem of this color comes from the bottom neighbour / leaves towards it
+			validDown |= down1 & receivers & (runUp | runLeft | runMiddleH | runRight);
+			validDown |= gems & ((receivers & (runDown | runLeft | runMiddleH | runRight)) >> COLS);
+		}
+	}
+
+	MoveIndex() : m_validRight(0), m_validDown(0), m_dirty(Bits::kAllCells)
+	{
+	}
+
+	void invalidate(Mask changedCells)	{ m_dirty |= changedCells; }
+	void invalidateAll()				{ m_dirty = Bits::kAllCells; }
+	bool isDirty() const				{ return m_dirty != 0; }
+
+	void refresh(const Bits& bits, int numGemTypes)
+	{
+		if (!m_dirty)
+			return;
+
+		m_dirty = 0;
+		findValidSwaps(bits.getGemMasks(), bits.getStaticMask(), numGemTypes, m_validRight, m_validDown);
+	}
+
+	// only meaningful after refresh()
+	Mask getValidRight() const	{ assert(!m_dirty); return m_validRight; }
+	Mask getValidDown() const	{ assert(!m_dirty); return m_validDown; }
+	bool hasValidMove() const	{ assert(!m_dirty); return (m_validRight | m_validDown) != 0; }
+};
+#endif//MOVE_INDEX_H
@@ -0,0 +1,329 @@
+#include "Profiler.h"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+#include <assert.h>
+
+using namespace std;
+
+static const int kOverlayRefreshFrames = 30;		// percentiles don't need to be sorted every frame
+static const int kOverlayLineHeight = 18;
+static const int kOverlayWidth = 300;
+
+static const char* const s_scopeNames[EPS_COUNT] = {
+	"frame",
+	"events",
+	"gfx update",
+	"board update",
+	"  swapping",
+	"  falling",
+	"  solving",
+	"board layer",
+	"board render",
+	"present"
+};
+
+#if defined(_MSC_VER)
+	#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+	#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+Profiler Profiler::s_mainInstance;
+static PROFILER_THREAD_LOCAL Profiler* s_pThreadInstance = nullptr;
+
+Profiler::Profiler() :
+	m_bEnabled(false),
+	m_ticksToUs(0.0),
+	m_frameStart(0),
+	m_historyIdx(0),
+	m_historySize(0),
+	m_traceStart(0),
+	m_traceFramesLeft(0),
+	m_traceFile(nullptr),
+	m_pTraceHandover(nullptr),
+	m_overlayRefreshFrames(0)
+{
+	memset(m_scopeStart, 0, sizeof(m_scopeStart));
+	memset(m_scopeDepth, 0, sizeof(m_scopeDepth));
+	memset(m_frameTicks, 0, sizeof(m_frameTicks));
+	memset(m_history_us, 0, sizeof(m_history_us));
+	memset(m_bRecorded, 0, sizeof(m_bRecorded));
+	memset(&m_remoteSummary, 0, sizeof(m_remoteSummary));
+}
+
+Profiler& Profiler::instance()
+{
+	return s_pThreadInstance ? *s_pThreadInstance : s_mainInstance;
+}
+
+void Profiler::setThreadInstance(Profiler* profiler)
+{
+	s_pThreadInstance = profiler;
+}
+
+Profiler::~Profiler()
+{
+}
+
+uint64_t Profiler::now()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+const char* Profiler::getScopeName(EProfileScope scope)
+{
+	return s_scopeNames[scope];
+}
+
+void Profiler::beginFrame()
+{
+	if (!m_bEnabled)
+		return;
+
+	if (m_ticksToUs == 0.0)
+	{
+		m_ticksToUs = 1e6 / static_cast<double>(SDL_GetPerformanceFrequency());
+	}
+	m_frameStart = now();
+}
+
+void Profiler::endFrame()
+{
+	if (!m_bEnabled)
+		return;
+
+	recordScope(EPS_FRAME, m_frameStart, now());
+
+	for (int i = 0; i < EPS_COUNT; ++i)
+	{
+		assert(m_scopeDepth[i] == 0 && "A scope is still open at the end of the frame");
+		m_history_us[i][m_historyIdx] = static_cast<float>(m_frameTicks[i] * m_ticksToUs);
+		m_frameTicks[i] = 0;
+	}
+	m_historyIdx = (m_historyIdx + 1) % kHistorySize;
+	m_historySize = min(m_historySize + 1, static_cast<int>(kHistorySize));
+
+	if (m_traceFramesLeft > 0 && --m_traceFramesLeft == 0)
+	{
+		writeTrace();
+	}
+
+	if (!m_overlayLabels.empty() && --m_overlayRefreshFrames <= 0)
+	{
+		refreshOverlay();
+		m_overlayRefreshFrames = kOverlayRefreshFrames;
+	}
+}
+
+void Profiler::recordScope(EProfileScope scope, uint64_t start, uint64_t end)
+{
+	m_frameTicks[scope] += end - start;
+	m_bRecorded[scope] = true;
+
+	if (m_traceFramesLeft > 0 && m_traceEvents.size() < m_traceEvents.capacity())
+	{
+		TraceEvent event;
+		event.start = start;
+		event.end = end;
+		event.scope = scope;
+		event.threadId = kTraceThreadId;
+		m_traceEvents.push_back(event);
+	}
+
+	if (m_pTraceHandover)
+	{
+		ProfileTraceEvent event;
+		event.start = start;
+		event.end = end;
+		event.scope = scope;
+		m_pTraceHandover->push(event);
+	}
+}
+
+void Profiler::recordRemoteScope(const ProfileTraceEvent& event, int threadId)
+{
+	//the other thread doesn't know about the capture, what ended before it started isn't part of it
+	if (m_traceFramesLeft > 0 && event.end >= m_traceStart && m_traceEvents.size() < m_traceEvents.capacity())
+	{
+		TraceEvent traceEvent;
+		traceEvent.start = event.start;
+		traceEvent.end = event.end;
+		traceEvent.scope = event.scope;
+		traceEvent.threadId = threadId;
+		m_traceEvents.push_back(traceEvent);
+	}
+}
+
+float Profiler::getPercentile_us(EProfileScope scope, float percentile) const
+{
+	if (m_historySize == 0)
+		return 0.f;
+
+	float sorted[kHistorySize];
+	memcpy(sorted, m_history_us[scope], m_historySize * sizeof(float));
+
+	int idx = static_cast<int>(percentile * 0.01f * (m_historySize - 1) + 0.5f);
+	nth_element(sorted, sorted + idx, sorted + m_historySize);
+	return sorted[idx];
+}
+
+float Profiler::getMax_us(EProfileScope scope) const
+{
+	if (m_historySize == 0)
+		return 0.f;
+	return *max_element(m_history_us[scope], m_history_us[scope] + m_historySize);
+}
+
+void Profiler::getSummary(ProfileSummary& summary) const
+{
+	for (int i = 0; i < EPS_COUNT; ++i)
+	{
+		EProfileScope scope = static_cast<EProfileScope>(i);
+		summary.recorded[i] = m_bRecorded[i];
+		summary.p50_us[i] = getPercentile_us(scope, 50.f);
+		summary.p99_us[i] = getPercentile_us(scope, 99.f);
+		summary.max_us[i] = getMax_us(scope);
+	}
+}
+
+void Profiler::startTraceCapture(int numFrames, const char* file)
+{
+	if (!m_bEnabled || isCapturingTrace())
+		return;
+
+	//reserved up front so that recording doesn't allocate in the middle of a frame
+	m_traceEvents.clear();
+	m_traceEvents.reserve(kMaxTraceEvents);
+	m_traceStart = now();
+	m_traceFramesLeft = numFrames;
+	m_traceFile = file;
+}
+
+void Profiler::writeTrace()
+{
+	ofstream out(m_traceFile);
+	if (!out)
+	{
+		cout << "Failed to write the trace to " << m_traceFile << endl;
+		return;
+	}
+
+	out << "{\"traceEvents\":[" << endl;
+	for (size_t i = 0, n = m_traceEvents.size(); i < n; ++i)
+	{
+		const TraceEvent& event = m_traceEvents[i];
+		//events before the capture started (a scope already open) are clamped to its start
+		uint64_t start = max(event.start, m_traceStart);
+		double ts_us = (start - m_traceStart) * m_ticksToUs;
+		double dur_us = (event.end - start) * m_ticksToUs;
+
+		out << "{\"name\":\"" << s_scopeNames[event.scope] + strspn(s_scopeNames[event.scope], " ") 
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId << ",\"ts\":" << ts_us << ",\"dur\":" << dur_us << "}"
+			<< (i + 1 < n ? "," : "") << endl;
+	}
+	out << "]}" << endl;
+
+	cout << "Wrote " << m_traceEvents.size() << " trace events to " << m_traceFile << endl;
+
+	m_traceEvents.clear();
+	m_traceEvents.shrink_to_fit();
+}
+
+// formats time_us as milliseconds with two decimals
+static char* appendTime(char* dst, float time_us)
+{
+	int hundredths = static_cast<int>(time_us * 0.1f + 0.5f);
+	int whole = hundredths / 100;
+	int frac = hundredths % 100;
+
+	char digits[12];
+	int numDigits = 0;
+	do
+	{
+		digits[numDigits++] = static_cast<char>('0' + whole % 10);
+		whole /= 10;
+	} while (whole);
+
+	while (numDigits > 0)
+	{
+		*dst++ = digits[--numDigits];
+	}
+	*dst++ = '.';
+	*dst++ = static_cast<char>('0' + frac / 10);
+	*dst++ = static_cast<char>('0' + frac % 10);
+	return dst;
+}
+
+static char* appendText(char* dst, const char* text)
+{
+	while (*text)
+	{
+		*dst++ = *text++;
+	}
+	return dst;
+}
+
+void Profiler::refreshOverlay()
+{
+	m_overlayLabels[0].setText("scope          p50 / p99 / max ms");
+	for (int i = 0; i < EPS_COUNT; ++i)
+	{
+		EProfileScope scope = static_cast<EProfileScope>(i);
+		bool isRemote = !m_bRecorded[i] && m_remoteSummary.recorded[i];
+
+		char text[TextLabel::kMaxLength + 1];
+		char* dst = appendText(text, s_scopeNames[i]);
+		dst = appendText(dst, ":  ");
+		dst = appendTime(dst, isRemote ? m_remoteSummary.p50_us[i] : getPercentile_us(scope, 50.f));
+		dst = appendText(dst, " / ");
+		dst = appendTime(dst, isRemote ? m_remoteSummary.p99_us[i] : getPercentile_us(scope, 99.f));
+		dst = appendText(dst, " / ");
+		dst = appendTime(dst, isRemote ? m_remoteSummary.max_us[i] : getMax_us(scope));
+		*dst = 0;
+
+		m_overlayLabels[i + 1].setText(text);
+	}
+}
+
+void Profiler::initOverlay(const GlyphAtlas* atlas)
+{
+	static const SDL_Color color = { 255, 255, 0, 255 };
+
+	m_overlayLabels.resize(EPS_COUNT + 1);
+	for (auto& label : m_overlayLabels)
+	{
+		label.init(atlas, color);
+	}
+	refreshOverlay();
+}
+
+void Profiler::releaseOverlay()
+{
+	m_overlayLabels.clear();
+}
+
+void Profiler::renderOverlay(SDL_Renderer* renderer, int x, int y)
+{
+	//darken what's behind so the text stays readable over the gems
+	SDL_Rect background;
+	background.x = x - 4;
+	background.y = y - 2;
+	background.w = kOverlayWidth;
+	background.h = m_overlayLabels.size() * kOverlayLineHeight + 4;
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+	SDL_RenderFillRect(renderer, &background);
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+	for (auto& label : m_overlayLabels)
+	{
+		label.render(renderer, x, y);
+		y += kOverlayLineHeight;
+	}
+}
@@ -0,0 +1,169 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "SpscQueue.h"
+#include "TextRenderer.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct SDL_Renderer;
+
+enum EProfileScope
+{
+	EPS_FRAME = 0,
+	EPS_EVENTS,
+	EPS_GFX_UPDATE,
+	EPS_BOARD_UPDATE,
+	EPS_BOARD_SWAPPING,
+	EPS_BOARD_FALLING,
+	EPS_BOARD_SOLVING,
+	EPS_BOARD_LAYER,
+	EPS_BOARD_RENDER,
+	EPS_PRESENT,
+	EPS_COUNT
+};
+
+// Percentiles of every scope, to show the scopes timed by another thread's profiler
+struct ProfileSummary
+{
+	bool recorded[EPS_COUNT];
+	float p50_us[EPS_COUNT];
+	float p99_us[EPS_COUNT];
+	float max_us[EPS_COUNT];
+};
+
+// A scope timed by another thread's profiler, handed over to the main one for its trace capture
+struct ProfileTraceEvent
+{
+	uint64_t start;
+	uint64_t end;
+	int scope;
+};
+typedef SpscQueue<ProfileTraceEvent, 1024> ProfileTraceQueue;
+
+// Scoped timers for the main loop. Every frame the time spent in each scope is summed up
+// and kept in a rolling history, from which p50/p99/max are shown in an overlay.
+// Scopes are inclusive: falling also contains the solving it triggers.
+// A capture records every scope as a Chrome trace event (chrome://tracing, about:tracing).
+// A profiler must only be used by one thread: threads other than the main one install their own
+// with setThreadInstance and hand their percentiles over with getSummary/setRemoteSummary, and their scopes
+// with setTraceHandover/recordRemoteScope so that a capture shows every thread.
+class Profiler
+{
+public:
+	static const int kHistorySize = 256;			// frames kept for the percentiles
+	static const int kMaxTraceEvents = 1 << 16;
+	static const int kTraceThreadId = 1;			// of the scopes this profiler timed itself
+
+private:
+	struct TraceEvent
+	{
+		uint64_t start;
+		uint64_t end;
+		int scope;
+		int threadId;
+	};
+
+	static Profiler s_mainInstance;
+
+	bool m_bEnabled;
+	double m_ticksToUs;
+	uint64_t m_frameStart;
+
+	uint64_t m_scopeStart[EPS_COUNT];
+	int m_scopeDepth[EPS_COUNT];
+	uint64_t m_frameTicks[EPS_COUNT];			// time spent in each scope this frame
+	bool m_bRecorded[EPS_COUNT];
+	ProfileSummary m_remoteSummary;				// used for the scopes this profiler never saw
+
+	float m_history_us[EPS_COUNT][kHistorySize];
+	int m_historyIdx;
+	int m_historySize;
+
+	std::vector<TraceEvent> m_traceEvents;
+	uint64_t m_traceStart;
+	int m_traceFramesLeft;
+	const char* m_traceFile;
+	ProfileTraceQueue* m_pTraceHandover;
+
+	std::vector<TextLabel> m_overlayLabels;
+	int m_overlayRefreshFrames;
+
+	Profiler(const Profiler&);
+	Profiler& operator=(const Profiler&);
+
+	void writeTrace();
+	void refreshOverlay();
+
+public:
+	Profiler();
+	~Profiler();
+
+	// the profiler of the calling thread, the main one unless the thread installed its own
+	static Profiler&	instance();
+	static void			setThreadInstance(Profiler* profiler);
+	static uint64_t		now();
+
+	void	setEnabled(bool enabled)	{ m_bEnabled = enabled; }
+	bool	isEnabled() const			{ return m_bEnabled; }
+
+	void	beginFrame();
+	void	endFrame();
+
+	void	beginScope(EProfileScope scope)
+	{
+		if (m_bEnabled && m_scopeDepth[scope]++ == 0)
+		{
+			m_scopeStart[scope] = now();
+		}
+	}
+	void	endScope(EProfileScope scope)
+	{
+		if (m_bEnabled && --m_scopeDepth[scope] == 0)
+		{
+			recordScope(scope, m_scopeStart[scope], now());
+		}
+	}
+	void	recordScope(EProfileScope scope, uint64_t start, uint64_t end);
+	// adds a scope timed by another thread to the trace being captured, under its own thread id
+	void	recordRemoteScope(const ProfileTraceEvent& event, int threadId);
+
+	// percentile in [0, 100] of the per frame time of a scope over the history
+	float	getPercentile_us(EProfileScope scope, float percentile) const;
+	float	getMax_us(EProfileScope scope) const;
+	static const char* getScopeName(EProfileScope scope);
+
+	void	getSummary(ProfileSummary& summary) const;
+	void	setRemoteSummary(const ProfileSummary& summary)	{ m_remoteSummary = summary; }
+
+	// records the next numFrames frames and writes them to file as a Chrome trace
+	void	startTraceCapture(int numFrames, const char* file);
+	bool	isCapturingTrace() const	{ return m_traceFramesLeft > 0; }
+	// another thread's profiler pushes every scope it records to queue, for the main one to pop.
+	// A full queue drops the scope
+	void	setTraceHandover(ProfileTraceQueue* queue)	{ m_pTraceHandover = queue; }
+
+	void	initOverlay(const GlyphAtlas* atlas);
+	void	releaseOverlay();
+	void	renderOverlay(SDL_Renderer* renderer, int x, int y);
+};
+
+class ProfileScope
+{
+private:
+	EProfileScope m_scope;
+
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+public:
+	explicit ProfileScope(EProfileScope scope) : m_scope(scope)	{ Profiler::instance().beginScope(scope); }
+	~ProfileScope()												{ Profiler::instance().endScope(m_scope); }
+};
+
+#define PROFILE_SCOPE_NAME2(line) profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(scope) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(scope)
+
+#endif//PROFILER_H
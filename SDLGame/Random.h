@@ -0,0 +1,78 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <assert.h>
+
+// Small, fast and seedable generator (xoshiro128**), meant to be owned by whoever draws from it
+// so that seeded runs are reproducible and separate instances never share state between threads.
+class Random
+{
+private:
+	uint32_t m_state[4];
+	uint64_t m_seed;
+
+	static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+	static uint64_t splitMix64(uint64_t& x)
+	{
+		uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+public:
+	explicit Random(uint64_t seed = 0) { setSeed(seed); }
+
+	// the state is expanded from the seed with splitmix64, so similar seeds give unrelated streams
+	void setSeed(uint64_t seed)
+	{
+		m_seed = seed;
+		uint64_t x = seed;
+		uint64_t a = splitMix64(x);
+		uint64_t b = splitMix64(x);
+		m_state[0] = static_cast<uint32_t>(a);
+		m_state[1] = static_cast<uint32_t>(a >> 32);
+		m_state[2] = static_cast<uint32_t>(b);
+		m_state[3] = static_cast<uint32_t>(b >> 32);
+	}
+	uint64_t getSeed() const { return m_seed; }
+	// one of the four words of the current state, e.g. to checksum it
+	uint32_t getState(int i) const { assert(i >= 0 && i < 4); return m_state[i]; }
+
+	uint32_t next()
+	{
+		uint32_t result = rotl(m_state[1] * 5, 7) * 9;
+		uint32_t t = m_state[1] << 9;
+
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= t;
+		m_state[3] = rotl(m_state[3], 11);
+
+		return result;
+	}
+
+	// uniform in [0, range) without modulo bias (Lemire's multiply and reject)
+	int nextInt(int range)
+	{
+		assert(range > 0);
+		uint32_t bound = static_cast<uint32_t>(range);
+		uint64_t m = static_cast<uint64_t>(next()) * bound;
+		uint32_t low = static_cast<uint32_t>(m);
+		if (low < bound)
+		{
+			uint32_t threshold = (0u - bound) % bound;
+			while (low < threshold)
+			{
+				m = static_cast<uint64_t>(next()) * bound;
+				low = static_cast<uint32_t>(m);
+			}
+		}
+		return static_cast<int>(m >> 32);
+	}
+};
+#endif//RANDOM_H
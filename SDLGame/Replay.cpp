@@ -0,0 +1,257 @@
+#include "Replay.h"
+#include "Board.h"
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include <assert.h>
+
+using namespace std;
+using namespace Replay;
+
+static const char kMagic[4] = { 'D', 'M', 'R', 'P' };
+
+static void writeVarint(vector<uint8_t>& data, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		data.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeFixed(vector<uint8_t>& data, uint64_t value, int numBytes)
+{
+	for (int i = 0; i < numBytes; ++i)
+	{
+		data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+	}
+}
+
+// reads from a byte range, every read fails once the data runs out
+class ReplayReader
+{
+private:
+	const uint8_t* m_pos;
+	const uint8_t* m_end;
+	bool m_bFailed;
+
+public:
+	ReplayReader(const uint8_t* begin, const uint8_t* end) : m_pos(begin), m_end(end), m_bFailed(false) {}
+
+	bool failed() const { return m_bFailed; }
+
+	uint64_t readVarint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (m_pos == m_end)
+				break;
+			uint8_t byte = *m_pos++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		m_bFailed = true;
+		return 0;
+	}
+
+	uint64_t readFixed(int numBytes)
+	{
+		if (m_end - m_pos < numBytes)
+		{
+			m_bFailed = true;
+			return 0;
+		}
+		uint64_t value = 0;
+		for (int i = 0; i < numBytes; ++i)
+		{
+			value |= static_cast<uint64_t>(*m_pos++) << (8 * i);
+		}
+		return value;
+	}
+};
+
+ReplayRecorder::ReplayRecorder() :
+	m_lastTick(0),
+	m_lastChecksum(0),
+	m_bHasChecksum(false),
+	m_bEnded(false)
+{
+}
+
+void ReplayRecorder::begin(int numGemTypes, uint64_t seed, float step_ms)
+{
+	//a minute of play is a few kilobytes, reserve enough that recording rarely allocates
+	m_data.clear();
+	m_data.reserve(64 * 1024);
+	m_lastTick = 0;
+	m_bHasChecksum = false;
+	m_bEnded = false;
+
+	m_data.insert(m_data.end(), kMagic, kMagic + sizeof(kMagic));
+	m_data.push_back(kVersion);
+	m_data.push_back(static_cast<uint8_t>(numGemTypes));
+	writeFixed(m_data, seed, 8);
+
+	uint32_t stepBits;
+	memcpy(&stepBits, &step_ms, sizeof(stepBits));
+	writeFixed(m_data, stepBits, 4);
+}
+
+void ReplayRecorder::writeRecordStart(ERecordType type, uint32_t tick)
+{
+	assert(!m_bEnded && tick >= m_lastTick);
+	m_data.push_back(static_cast<uint8_t>(type));
+	writeVarint(m_data, tick - m_lastTick);
+	m_lastTick = tick;
+}
+
+void ReplayRecorder::recordInput(uint32_t tick, const InputEvent& event)
+{
+	writeRecordStart(static_cast<ERecordType>(event.type), tick);
+	switch (event.type)
+	{
+		case InputEvent::EIT_MOUSE_DOWN:
+		case InputEvent::EIT_MOUSE_UP:
+			//clicks outside the window are ignored by the board anyway
+			writeVarint(m_data, static_cast<uint64_t>(max(event.x, 0)));
+			writeVarint(m_data, static_cast<uint64_t>(max(event.y, 0)));
+			break;
+		case InputEvent::EIT_RESTART_GAME:
+			writeFixed(m_data, event.seed, 8);
+			break;
+		default:
+			break;
+	}
+}
+
+void ReplayRecorder::recordChecksum(uint32_t tick, uint32_t checksum)
+{
+	if (m_bHasChecksum && checksum == m_lastChecksum)
+		return;
+
+	writeRecordStart(ERT_CHECKSUM, tick);
+	writeFixed(m_data, checksum, 4);
+	m_lastChecksum = checksum;
+	m_bHasChecksum = true;
+}
+
+void ReplayRecorder::end(uint32_t tick)
+{
+	writeRecordStart(ERT_END, tick);
+	m_bEnded = true;
+}
+
+bool ReplayRecorder::save(const char* file) const
+{
+	ofstream out(file, ios::binary);
+	if (!out)
+		return false;
+	out.write(reinterpret_cast<const char*>(m_data.data()), m_data.size());
+	return out.good();
+}
+
+bool ReplayPlayer::load(const char* file)
+{
+	ifstream in(file, ios::binary);
+	if (!in)
+		return false;
+	m_data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return true;
+}
+
+ReplayPlayer::Result ReplayPlayer::play() const
+{
+	Result result;
+	result.valid = false;
+	result.matched = true;
+	result.numTicks = 0;
+	result.firstMismatchTick = 0;
+	result.score = 0;
+
+	if (m_data.size() < static_cast<size_t>(kHeaderSize) || memcmp(m_data.data(), kMagic, sizeof(kMagic)) != 0)
+		return result;
+
+	ReplayReader reader(m_data.data() + sizeof(kMagic), m_data.data() + m_data.size());
+	int version = static_cast<int>(reader.readFixed(1));
+	int numGemTypes = static_cast<int>(reader.readFixed(1));
+	uint64_t seed = reader.readFixed(8);
+	uint32_t stepBits = static_cast<uint32_t>(reader.readFixed(4));
+	float step_ms;
+	memcpy(&step_ms, &stepBits, sizeof(step_ms));
+	if (version != kVersion || numGemTypes <= 0 || numGemTypes > kBoardMaxGemTypes || !(step_ms > 0.f))
+		return result;
+
+	Board board(numGemTypes,
+				kDefaultGemW,
+				kDefaultGemH,
+				kDefaultBoardBoundsXMin,
+				kDefaultBoardBoundsYMin,
+				kDefaultBoardW,
+				kDefaultBoardH,
+				/*pAssetMgr =*/nullptr,
+				/*pGfxMgr =*/nullptr);
+	GameSession session(board, seed, step_ms);
+
+	uint32_t expectedChecksum = 0;
+	uint32_t tick = 0;
+	while (true)
+	{
+		ERecordType type = static_cast<ERecordType>(reader.readFixed(1));
+		tick += static_cast<uint32_t>(reader.readVarint());
+		if (reader.failed() || type > ERT_END)
+			return result;
+
+		while (session.getTick() < tick)
+		{
+			session.step();
+			//the checksum of the tick just reached is checked against the record itself
+			if (session.getTick() == tick && type == ERT_CHECKSUM)
+				break;
+
+			if (result.matched && board.computeChecksum() != expectedChecksum)
+			{
+				result.matched = false;
+				result.firstMismatchTick = session.getTick();
+			}
+		}
+
+		if (type == ERT_END)
+			break;
+
+		if (type == ERT_CHECKSUM)
+		{
+			expectedChecksum = static_cast<uint32_t>(reader.readFixed(4));
+			if (result.matched && board.computeChecksum() != expectedChecksum)
+			{
+				result.matched = false;
+				result.firstMismatchTick = session.getTick();
+			}
+			continue;
+		}
+
+		InputEvent event(static_cast<InputEvent::EType>(type));
+		if (type == ERT_MOUSE_DOWN || type == ERT_MOUSE_UP)
+		{
+			event.x = static_cast<int>(reader.readVarint());
+			event.y = static_cast<int>(reader.readVarint());
+		}
+		else if (type == ERT_RESTART_GAME)
+		{
+			event.seed = reader.readFixed(8);
+		}
+		if (reader.failed())
+			return result;
+		session.handleInput(event);
+	}
+
+	result.valid = true;
+	result.numTicks = session.getTick();
+	result.score = board.getScore();
+	return result;
+}
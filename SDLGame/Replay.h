@@ -0,0 +1,82 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "GameSession.h"
+
+#include <cstdint>
+#include <vector>
+
+// Replay files are a small header followed by a stream of records, all integers little endian:
+//   header:	"DMRP", version (u8), numGemTypes (u8), seed (u64), step_ms (f32 bits, u32)
+//   record:	type (u8), ticks since the previous record (varint), then per type
+//				mouse down/up: x, y (varints)		restart: seed (u64)
+//				checksum: board checksum (u32)		start, hint, end: nothing
+// Inputs are applied before the step of their tick. A checksum is the board state after reaching
+// its tick, and is only written when it changed, so every tick can be verified on playback.
+namespace Replay
+{
+	enum ERecordType
+	{
+		ERT_MOUSE_DOWN = InputEvent::EIT_MOUSE_DOWN,
+		ERT_MOUSE_UP = InputEvent::EIT_MOUSE_UP,
+		ERT_START_GAME = InputEvent::EIT_START_GAME,
+		ERT_RESTART_GAME = InputEvent::EIT_RESTART_GAME,
+		ERT_SHOW_HINT = InputEvent::EIT_SHOW_HINT,
+		ERT_CHECKSUM = InputEvent::EIT_COUNT,
+		ERT_END
+	};
+
+	// bumped whenever the board rules change, older recordings wouldn't verify anymore
+	// 2: falling gems can land out of order
+	// 3: falls follow the exact constant acceleration instead of a step by step integration
+	// 4: new boards come from BoardGenerator
+	static const uint8_t kVersion = 4;
+	static const int kHeaderSize = 4 + 1 + 1 + 8 + 4;
+};
+
+class ReplayRecorder
+{
+private:
+	std::vector<uint8_t> m_data;
+	uint32_t m_lastTick;
+	uint32_t m_lastChecksum;
+	bool m_bHasChecksum;
+	bool m_bEnded;
+
+	void writeRecordStart(Replay::ERecordType type, uint32_t tick);
+
+public:
+	ReplayRecorder();
+
+	void begin(int numGemTypes, uint64_t seed, float step_ms);
+	void recordInput(uint32_t tick, const InputEvent& event);
+	void recordChecksum(uint32_t tick, uint32_t checksum);
+	void end(uint32_t tick);
+
+	bool save(const char* file) const;
+	const std::vector<uint8_t>& getData() const { return m_data; }
+};
+
+// Feeds a recording back into a headless board as fast as it can, checking the board checksum of every tick
+class ReplayPlayer
+{
+public:
+	struct Result
+	{
+		bool valid;				// false if the file couldn't be read or parsed
+		bool matched;			// every checksum matched
+		uint32_t numTicks;
+		uint32_t firstMismatchTick;
+		int score;
+	};
+
+private:
+	std::vector<uint8_t> m_data;
+
+public:
+	bool load(const char* file);
+	void setData(const std::vector<uint8_t>& data) { m_data = data; }
+
+	Result play() const;
+};
+#endif//REPLAY_H
@@ -0,0 +1,118 @@
+#ifndef RUN_KERNEL_H
+#define RUN_KERNEL_H
+
+#include "BitBoard.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define RUN_KERNEL_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RUN_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+// Finds the runs of 3+ of all the colors at once, straight from the colors of the cells: one byte per cell,
+// row after row, a negative color being a cell without a static gem (empty or swapping).
+// A cell starts a horizontal run when it holds a gem and the next two cells hold the same color, a vertical
+// run with the two cells below it. The cells are compared with themselves shifted by one cell and by one row,
+// 16 or 32 bytes per instruction with SSE2 or AVX2, and the comparisons of 64 cells packed in a word: the
+// shifts by two cells and two rows are then done on the masks.
+// The runs of one color are the runs found here AND the gem mask of that color, since a run holds only one color
+template <int ROWS, int COLS>
+class RunKernel
+{
+public:
+	typedef BitBoardMasks<ROWS, COLS> Masks;
+	typedef typename Masks::Mask Mask;
+
+	static const int kNumCells = ROWS * COLS;
+
+private:
+	static const int kNumWords = (kNumCells + 63) / 64;
+	// the cells are copied with a row of padding after the last word, for the comparisons with the row below.
+	// The padding isn't a gem so nothing past the board is ever part of a run
+	static const int kPaddedCells = 64 * kNumWords + COLS;
+	static const int8_t kPaddingColor = -1;
+
+	RunKernel();
+
+	// For the 64 cells at p, bit i of: gems is set when p[i] is a gem, sameRight when p[i] == p[i + 1],
+	// sameBelow when p[i] == p[i + COLS]
+	static void compareCells(const int8_t* p, uint64_t& gems, uint64_t& sameRight, uint64_t& sameBelow)
+	{
+#if defined(RUN_KERNEL_AVX2)
+		const __m256i noGem = _mm256_set1_epi8(-1);
+		gems = sameRight = sameBelow = 0;
+		for (int half = 0; half < 2; ++half)
+		{
+			const int8_t* q = p + 32 * half;
+			__m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+			__m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 1));
+			__m256i below = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + COLS));
+			gems |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(cells, noGem)))) << (32 * half);
+			sameRight |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, right)))) << (32 * half);
+			sameBelow |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, below)))) << (32 * half);
+		}
+#elif defined(RUN_KERNEL_SSE2)
+		const __m128i noGem = _mm_set1_epi8(-1);
+		gems = sameRight = sameBelow = 0;
+		for (int quarter = 0; quarter < 4; ++quarter)
+		{
+			const int8_t* q = p + 16 * quarter;
+			__m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+			__m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 1));
+			__m128i below = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + COLS));
+			gems |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(cells, noGem)))) << (16 * quarter);
+			sameRight |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(cells, right)))) << (16 * quarter);
+			sameBelow |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(cells, below)))) << (16 * quarter);
+		}
+#else
+		gems = sameRight = sameBelow = 0;
+		for (int i = 0; i < 64; ++i)
+		{
+			gems |= static_cast<uint64_t>(p[i] >= 0) << i;
+			sameRight |= static_cast<uint64_t>(p[i] == p[i + 1]) << i;
+			sameBelow |= static_cast<uint64_t>(p[i] == p[i + COLS]) << i;
+		}
+#endif
+	}
+
+public:
+	// the cells of every horizontal and every vertical run of 3+, cells has kNumCells colors
+	static void findRuns(const int8_t* cells, Mask& horizontal, Mask& vertical)
+	{
+		int8_t padded[kPaddedCells];
+		memcpy(padded, cells, kNumCells);
+		memset(padded + kNumCells, kPaddingColor, kPaddedCells - kNumCells);
+
+		uint64_t gemWords[kNumWords];
+		uint64_t sameRightWords[kNumWords];
+		uint64_t sameBelowWords[kNumWords];
+		for (int word = 0; word < kNumWords; ++word)
+		{
+			compareCells(padded + 64 * word, gemWords[word], sameRightWords[word], sameBelowWords[word]);
+		}
+		Mask gems = MaskOf<kNumCells>::fromWords(gemWords);
+		Mask sameRight = MaskOf<kNumCells>::fromWords(sameRightWords);
+		Mask sameBelow = MaskOf<kNumCells>::fromWords(sameBelowWords);
+
+		//a gem equal to the next cell, itself equal to the one after, is a gem too. A horizontal run can't
+		//start on the last two columns, it would go on with the next row
+		Mask horizontalStarts = gems & sameRight & (sameRight >> 1) & Masks::kHorizontalRunStarts;
+		Mask verticalStarts = gems & sameBelow & (sameBelow >> COLS);
+		horizontal = horizontalStarts | (horizontalStarts << 1) | (horizontalStarts << 2);
+		vertical = verticalStarts | (verticalStarts << COLS) | (verticalStarts << (2 * COLS));
+	}
+
+	static Mask findRuns(const int8_t* cells)
+	{
+		Mask horizontal;
+		Mask vertical;
+		findRuns(cells, horizontal, vertical);
+		return horizontal | vertical;
+	}
+};
+#endif//RUN_KERNEL_H
@@ -0,0 +1,48 @@
+#include "SpriteBatch.h"
+
+#include <SDL.h>
+
+#include <assert.h>
+
+SpriteBatch::SpriteBatch(int capacity) :
+	m_pTexture(nullptr)
+{
+	m_srcRects.reserve(capacity);
+	m_dstRects.reserve(capacity);
+}
+
+void SpriteBatch::begin(SDL_Texture* texture)
+{
+	assert(m_srcRects.empty() && "The previous batch wasn't flushed");
+	m_pTexture = texture;
+}
+
+void SpriteBatch::add(const SDL_Rect& src, int x, int y)
+{
+	assert(m_pTexture);
+	SDL_Rect dst;
+	dst.x = x;
+	dst.y = y;
+	dst.w = src.w;
+	dst.h = src.h;
+
+	m_srcRects.push_back(src);
+	m_dstRects.push_back(dst);
+}
+
+int SpriteBatch::flush(SDL_Renderer* renderer)
+{
+	//SDL 2.0.3 has no call that takes several quads at once, but every copy here uses the
+	//same texture and rects computed up front, so the renderer never has to rebind anything
+	int numSprites = m_srcRects.size();
+	for (int i = 0; i < numSprites; ++i)
+	{
+		SDL_RenderCopy(renderer, m_pTexture, &m_srcRects[i], &m_dstRects[i]);
+	}
+
+	//clear() keeps the capacity, so a steady frame doesn't allocate
+	m_srcRects.clear();
+	m_dstRects.clear();
+	m_pTexture = nullptr;
+	return numSprites;
+}
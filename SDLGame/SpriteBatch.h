@@ -0,0 +1,33 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <SDL_rect.h>
+
+#include <vector>
+
+struct SDL_Texture;
+struct SDL_Renderer;
+
+// Collects the sprites of a frame that all come from one atlas texture and submits them together,
+// so nothing is queried or switched per sprite.
+class SpriteBatch
+{
+private:
+	SDL_Texture* m_pTexture;
+	std::vector<SDL_Rect> m_srcRects;
+	std::vector<SDL_Rect> m_dstRects;
+
+	SpriteBatch(const SpriteBatch&);
+	SpriteBatch& operator=(const SpriteBatch&);
+
+public:
+	explicit SpriteBatch(int capacity);
+
+	void begin(SDL_Texture* texture);
+	void add(const SDL_Rect& src, int x, int y);
+	// draws everything added since begin() and empties the batch
+	int flush(SDL_Renderer* renderer);
+
+	int getNumSprites() const { return m_srcRects.size(); }
+};
+#endif//SPRITE_BATCH_H
@@ -0,0 +1,52 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+// Fixed size ring buffer between exactly one producer thread and one consumer thread.
+// Both push and pop finish in a bounded number of steps: a full queue rejects the push
+// instead of waiting.
+template <class T, unsigned int CAPACITY>
+class SpscQueue
+{
+private:
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "The capacity must be a power of two.");
+	static const int kCacheLineSize = 64;
+
+	T m_items[CAPACITY];
+	// the indices only ever grow, they wrap around on their own
+	std::atomic<unsigned int> m_head;	// next item to pop, written by the consumer
+	char m_padding[kCacheLineSize];		// keeps the two indices on different cache lines
+	std::atomic<unsigned int> m_tail;	// next free slot, written by the producer
+
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+
+public:
+	SpscQueue() : m_head(0), m_tail(0) {}
+
+	// producer
+	bool push(const T& item)
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+
+		m_items[tail & (CAPACITY - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer
+	bool pop(T& item)
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_items[head & (CAPACITY - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+#endif//SPSC_QUEUE_H
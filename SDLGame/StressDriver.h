@@ -0,0 +1,130 @@
+#ifndef STRESS_DRIVER_H
+#define STRESS_DRIVER_H
+
+#include "Board.h"
+#include "Random.h"
+#include "Common.h"
+
+#include <memory>
+#include <chrono>
+#include <iostream>
+
+#include <assert.h>
+
+// Plays one of the larger board instantiations (LargeBoard, HugeBoard) without a window, the same way
+// HeadlessDriver plays the game board: random neighbours are swapped every few frames and a new game starts
+// when the timer runs out. The clicks go straight to the board, there is no GameSession or replay at these sizes
+template <class BoardT>
+class StressDriver
+{
+private:
+	// small tiles, so that even the largest boards stay within int pixel coordinates
+	static const int kGemSize = 8;
+
+	std::unique_ptr<BoardT> m_pBoard;
+	Random m_inputRandom;
+
+	uint64_t m_seed;
+	float m_dt_ms;
+	int m_framesPerMove;
+
+	long long m_framesSimulated;
+	int m_gamesPlayed;
+	long long m_totalScore;
+	double m_elapsed_s;
+
+	StressDriver(const StressDriver&);
+	StressDriver& operator=(const StressDriver&);
+
+	void click(int row, int col)
+	{
+		Utils::Point pos = m_pBoard->getTileCenter(row, col);
+		m_pBoard->mouseEvent(pos.x, pos.y, true);
+		m_pBoard->mouseEvent(pos.x, pos.y, false);
+	}
+
+	void scriptInput(long long frame)
+	{
+		if (frame % m_framesPerMove != 0)
+			return;
+
+		int row = m_inputRandom.nextInt(BoardT::kRows);
+		int col = m_inputRandom.nextInt(BoardT::kCols);
+		int dir = m_inputRandom.nextInt(4);
+
+		int otherRow = row + (dir == 0 ? -1 : (dir == 1 ? 1 : 0));
+		int otherCol = col + (dir == 2 ? -1 : (dir == 3 ? 1 : 0));
+		if (otherRow < 0 || otherRow >= BoardT::kRows || otherCol < 0 || otherCol >= BoardT::kCols)
+			return;
+
+		click(row, col);
+		click(otherRow, otherCol);
+	}
+
+	void startGame()
+	{
+		//every game gets its own seed, derived from the driver seed
+		m_pBoard->init(m_seed + m_gamesPlayed);
+		m_pBoard->setGameRunning(true);
+	}
+
+public:
+	StressDriver(int numGemTypes, uint64_t seed, float dt_ms, int framesPerMove) :
+		m_inputRandom(seed),
+		m_seed(seed),
+		m_dt_ms(dt_ms),
+		m_framesPerMove(framesPerMove),
+		m_framesSimulated(0),
+		m_gamesPlayed(0),
+		m_totalScore(0),
+		m_elapsed_s(0.0)
+	{
+		assert(framesPerMove > 0);
+		m_pBoard.reset(new BoardT(	numGemTypes,
+									kGemSize,
+									kGemSize,
+									/*boardBoundsXMin =*/0,
+									/*boardBoundsYMin =*/0,
+									BoardT::kCols * kGemSize,
+									BoardT::kRows * kGemSize,
+									/*pAssetMgr =*/nullptr,
+									/*pGfxMgr =*/nullptr));
+		startGame();
+	}
+
+	// Simulates numFrames frames, starting a new game whenever the timer runs out
+	void run(long long numFrames)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		for (long long frame = 0; frame < numFrames; ++frame)
+		{
+			scriptInput(m_framesSimulated);
+			m_pBoard->update(m_dt_ms);
+			++m_framesSimulated;
+
+			if (m_pBoard->getSecondsLeft() == 0)
+			{
+				m_totalScore += m_pBoard->getScore();
+				++m_gamesPlayed;
+				startGame();
+			}
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_elapsed_s += std::chrono::duration<double>(endTime - startTime).count();
+	}
+
+	void printStats() const
+	{
+		double framesPerSecond = m_elapsed_s > 0.0 ? m_framesSimulated / m_elapsed_s : 0.0;
+		double usPerFrame = m_framesSimulated > 0 ? (m_elapsed_s * 1e6) / m_framesSimulated : 0.0;
+
+		std::cout << "stress: " << BoardT::kRows << "x" << BoardT::kCols << " board, seed " << m_seed << std::endl;
+		std::cout << "stress: " << m_framesSimulated << " frames in " << m_elapsed_s << " s" << std::endl;
+		std::cout << "stress: " << framesPerSecond << " frames/s, " << usPerFrame << " us/frame" << std::endl;
+		std::cout << "stress: " << m_gamesPlayed << " games finished, total score " << m_totalScore + m_pBoard->getScore() << std::endl;
+		std::cout << "stress: checksum " << m_pBoard->computeChecksum() << std::endl;
+	}
+};
+#endif//STRESS_DRIVER_H
@@ -0,0 +1,255 @@
+#include "TextRenderer.h"
+#include "Common.h"
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <cstring>
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace std;
+
+static const int kAtlasWidth = 512;
+static const int kGlyphPadding = 1;
+
+GlyphAtlas::GlyphAtlas() :
+	m_pTexture(nullptr),
+	m_lineHeight(0)
+{
+	memset(m_glyphs, 0, sizeof(m_glyphs));
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+	release();
+}
+
+void GlyphAtlas::release()
+{
+	if (m_pTexture)
+	{
+		SDL_DestroyTexture(m_pTexture);
+		m_pTexture = nullptr;
+	}
+}
+
+bool GlyphAtlas::build(SDL_Renderer* renderer, _TTF_Font* font)
+{
+	assert(!m_pTexture);
+	static const SDL_Color white = { 255, 255, 255, 255 };
+
+	SDL_Surface* glyphSurfaces[kNumGlyphs];
+	memset(glyphSurfaces, 0, sizeof(glyphSurfaces));
+
+	m_lineHeight = TTF_FontHeight(font);
+
+	//rasterize every glyph and pack them in rows
+	int penX = 0;
+	int penY = 0;
+	int rowHeight = 0;
+	bool success = true;
+	for (int i = 0; i < kNumGlyphs; ++i)
+	{
+		char text[2] = { static_cast<char>(kFirstGlyph + i), 0 };
+		Glyph& glyph = m_glyphs[i];
+
+		int minX, maxX, minY, maxY, advance;
+		if (TTF_GlyphMetrics(font, text[0], &minX, &maxX, &minY, &maxY, &advance) != 0)
+		{
+			Utils::logSDLError("TTF_GlyphMetrics");
+			success = false;
+			break;
+		}
+		glyph.advance = advance;
+		glyph.offsetX = min(minX, 0);
+
+		if (text[0] == ' ')
+		{
+			//nothing to draw, only the advance matters
+			glyph.src.x = glyph.src.y = glyph.src.w = glyph.src.h = 0;
+			continue;
+		}
+
+		SDL_Surface* surf = TTF_RenderText_Blended(font, text, white);
+		if (surf == nullptr)
+		{
+			Utils::logSDLError("TTF_RenderText");
+			success = false;
+			break;
+		}
+		glyphSurfaces[i] = surf;
+
+		if (penX + surf->w > kAtlasWidth)
+		{
+			penX = 0;
+			penY += rowHeight + kGlyphPadding;
+			rowHeight = 0;
+		}
+		glyph.src.x = penX;
+		glyph.src.y = penY;
+		glyph.src.w = surf->w;
+		glyph.src.h = surf->h;
+
+		penX += surf->w + kGlyphPadding;
+		rowHeight = max(rowHeight, surf->h);
+	}
+
+	SDL_Surface* atlas = nullptr;
+	if (success)
+	{
+		atlas = SDL_CreateRGBSurface(0, kAtlasWidth, penY + rowHeight, 32, 
+									0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+		if (atlas == nullptr)
+		{
+			Utils::logSDLError("CreateRGBSurface");
+			success = false;
+		}
+	}
+
+	if (success)
+	{
+		for (int i = 0; i < kNumGlyphs; ++i)
+		{
+			if (glyphSurfaces[i])
+			{
+				//copy the alpha as is instead of blending it over the empty atlas
+				SDL_SetSurfaceBlendMode(glyphSurfaces[i], SDL_BLENDMODE_NONE);
+				SDL_BlitSurface(glyphSurfaces[i], nullptr, atlas, &m_glyphs[i].src);
+			}
+		}
+
+		m_pTexture = SDL_CreateTextureFromSurface(renderer, atlas);
+		if (m_pTexture == nullptr)
+		{
+			Utils::logSDLError("CreateTexture");
+			success = false;
+		}
+		else
+		{
+			SDL_SetTextureBlendMode(m_pTexture, SDL_BLENDMODE_BLEND);
+		}
+	}
+
+	for (int i = 0; i < kNumGlyphs; ++i)
+	{
+		SDL_FreeSurface(glyphSurfaces[i]);
+	}
+	SDL_FreeSurface(atlas);
+
+	return success;
+}
+
+TextLabel::TextLabel() :
+	m_pAtlas(nullptr),
+	m_prefix(nullptr),
+	m_value(0),
+	m_bHasValue(false),
+	m_numQuads(0),
+	m_width(0)
+{
+	m_text[0] = 0;
+	m_color.r = m_color.g = m_color.b = m_color.a = 255;
+}
+
+void TextLabel::init(const GlyphAtlas* atlas, SDL_Color color)
+{
+	m_pAtlas = atlas;
+	m_color = color;
+	layout();
+}
+
+void TextLabel::setText(const char* text)
+{
+	if (!m_bHasValue && strcmp(text, m_text) == 0)
+		return;
+
+	m_bHasValue = false;
+	strncpy(m_text, text, kMaxLength);
+	m_text[kMaxLength] = 0;
+	layout();
+}
+
+void TextLabel::setTextWithValue(const char* prefix, int value)
+{
+	if (m_bHasValue && m_value == value && m_prefix == prefix)
+		return;
+
+	m_bHasValue = true;
+	m_prefix = prefix;
+	m_value = value;
+
+	//format without going through a stream so no memory is allocated
+	char digits[12];
+	int numDigits = 0;
+	unsigned int absValue = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+	do
+	{
+		digits[numDigits++] = static_cast<char>('0' + absValue % 10);
+		absValue /= 10;
+	} while (absValue);
+
+	int length = 0;
+	for (const char* c = prefix; *c && length < kMaxLength; ++c)
+	{
+		m_text[length++] = *c;
+	}
+	if (value < 0 && length < kMaxLength)
+	{
+		m_text[length++] = '-';
+	}
+	while (numDigits > 0 && length < kMaxLength)
+	{
+		m_text[length++] = digits[--numDigits];
+	}
+	m_text[length] = 0;
+
+	layout();
+}
+
+void TextLabel::layout()
+{
+	m_numQuads = 0;
+	m_width = 0;
+	if (!m_pAtlas)
+		return;
+
+	int penX = 0;
+	for (const char* c = m_text; *c; ++c)
+	{
+		if (!m_pAtlas->hasGlyph(*c))
+			continue;
+
+		const GlyphAtlas::Glyph& glyph = m_pAtlas->getGlyph(*c);
+		if (glyph.src.w > 0)
+		{
+			m_srcRects[m_numQuads] = glyph.src;
+			m_dstRects[m_numQuads].x = penX + glyph.offsetX;
+			m_dstRects[m_numQuads].y = 0;
+			m_dstRects[m_numQuads].w = glyph.src.w;
+			m_dstRects[m_numQuads].h = glyph.src.h;
+			++m_numQuads;
+		}
+		penX += glyph.advance;
+	}
+	m_width = penX;
+}
+
+void TextLabel::render(SDL_Renderer* renderer, int x, int y) const
+{
+	if (!m_pAtlas || !m_numQuads)
+		return;
+
+	//every quad comes from the same texture, so there is no texture switch between glyphs
+	SDL_Texture* texture = m_pAtlas->getTexture();
+	SDL_SetTextureColorMod(texture, m_color.r, m_color.g, m_color.b);
+	SDL_SetTextureAlphaMod(texture, m_color.a);
+	for (int i = 0; i < m_numQuads; ++i)
+	{
+		SDL_Rect dst = m_dstRects[i];
+		dst.x += x;
+		dst.y += y;
+		SDL_RenderCopy(renderer, texture, &m_srcRects[i], &dst);
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <SDL_rect.h>
+#include <SDL_pixels.h>
+
+struct SDL_Texture;
+struct SDL_Renderer;
+struct _TTF_Font;
+
+// All the printable ASCII glyphs of a font, rasterized once in white into a single texture.
+// Text of any color is drawn from it by tinting the texture.
+class GlyphAtlas
+{
+public:
+	static const char kFirstGlyph = ' ';
+	static const char kLastGlyph = '~';
+	static const int kNumGlyphs = kLastGlyph - kFirstGlyph + 1;
+
+	struct Glyph
+	{
+		SDL_Rect src;	// where the glyph is in the atlas texture
+		int offsetX;	// where it is drawn relative to the pen position
+		int advance;	// how much it moves the pen
+	};
+
+private:
+	SDL_Texture* m_pTexture;
+	Glyph m_glyphs[kNumGlyphs];
+	int m_lineHeight;
+
+	GlyphAtlas(const GlyphAtlas&);
+	GlyphAtlas& operator=(const GlyphAtlas&);
+
+public:
+	GlyphAtlas();
+	~GlyphAtlas();
+
+	bool build(SDL_Renderer* renderer, _TTF_Font* font);
+	void release();
+
+	SDL_Texture*	getTexture() const		{ return m_pTexture; }
+	int				getLineHeight() const	{ return m_lineHeight; }
+	bool			hasGlyph(char c) const	{ return c >= kFirstGlyph && c <= kLastGlyph; }
+	const Glyph&	getGlyph(char c) const	{ return m_glyphs[c - kFirstGlyph]; }
+};
+
+// A line of text drawn from a GlyphAtlas. The glyph quads are only laid out again when the
+// text actually changes, so drawing an unchanged label doesn't allocate or upload anything.
+class TextLabel
+{
+public:
+	static const int kMaxLength = 64;
+
+private:
+	const GlyphAtlas* m_pAtlas;
+	SDL_Color m_color;
+
+	char m_text[kMaxLength + 1];
+	const char* m_prefix;
+	int m_value;
+	bool m_bHasValue;
+
+	SDL_Rect m_srcRects[kMaxLength];
+	SDL_Rect m_dstRects[kMaxLength];	// relative to the label position
+	int m_numQuads;
+	int m_width;
+
+	void layout();
+
+public:
+	TextLabel();
+
+	void init(const GlyphAtlas* atlas, SDL_Color color);
+
+	void setText(const char* text);
+	// shows prefix followed by value; prefix must outlive the label since it is compared by address
+	void setTextWithValue(const char* prefix, int value);
+
+	void render(SDL_Renderer* renderer, int x, int y) const;
+
+	const char*	getText() const		{ return m_text; }
+	int			getWidth() const	{ return m_width; }
+};
+#endif//TEXT_RENDERER_H
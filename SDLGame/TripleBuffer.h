@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread without locks.
+// The writer fills the back buffer and publishes it by swapping it with the middle one;
+// the reader swaps the middle one with its front buffer when something new was published.
+// Neither side ever waits, and the reader never sees a buffer that is being written.
+template <class T>
+class TripleBuffer
+{
+private:
+	static const int kIndexMask = 3;
+	static const int kNewDataBit = 4;
+
+	T m_buffers[3];
+	std::atomic<int> m_middle;	// index of the middle buffer | kNewDataBit if it wasn't read yet
+	int m_back;					// only touched by the writer
+	int m_front;				// only touched by the reader
+
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+public:
+	TripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+
+	// writer
+	T&		getWriteBuffer()	{ return m_buffers[m_back]; }
+	void	publish()
+	{
+		int oldMiddle = m_middle.exchange(m_back | kNewDataBit, std::memory_order_acq_rel);
+		m_back = oldMiddle & kIndexMask;
+	}
+
+	// reader, returns true if the front buffer changed
+	bool	acquire()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & kNewDataBit) == 0)
+			return false;
+
+		int oldMiddle = m_middle.exchange(m_front, std::memory_order_acq_rel);
+		m_front = oldMiddle & kIndexMask;
+		return true;
+	}
+	const T&	getReadBuffer() const	{ return m_buffers[m_front]; }
+};
+#endif//TRIPLE_BUFFER_H
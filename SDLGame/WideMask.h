@@ -0,0 +1,205 @@
+#ifndef WIDE_MASK_H
+#define WIDE_MASK_H
+
+#include "BitUtils.h"
+
+#include <cstdint>
+#include <assert.h>
+
+// A bit mask of WORDS 64-bit words with the operators of an integer, for the bitboards of boards
+// with more than 64 cells. Bit i is bit i % 64 of word i / 64, shifts carry across the words
+template <int WORDS>
+class WideMask
+{
+private:
+	// tests as a bool without converting to an integer, so mixing a mask with an integer always means the mask
+	typedef void (WideMask::*BoolType)() const;
+	void isTrue() const {}
+
+public:
+	uint64_t words[WORDS];
+
+	WideMask()
+	{
+		for (int i = 0; i < WORDS; ++i)
+		{
+			words[i] = 0;
+		}
+	}
+	WideMask(uint64_t low)
+	{
+		words[0] = low;
+		for (int i = 1; i < WORDS; ++i)
+		{
+			words[i] = 0;
+		}
+	}
+
+	static WideMask bit(int idx)
+	{
+		assert(idx >= 0 && idx < 64 * WORDS);
+		WideMask m;
+		m.words[idx / 64] = 1ULL << (idx % 64);
+		return m;
+	}
+
+	bool isZero() const
+	{
+		uint64_t any = 0;
+		for (int i = 0; i < WORDS; ++i)
+		{
+			any |= words[i];
+		}
+		return any == 0;
+	}
+	operator BoolType() const { return isZero() ? nullptr : &WideMask::isTrue; }
+
+	WideMask operator~() const
+	{
+		WideMask m;
+		for (int i = 0; i < WORDS; ++i)
+		{
+			m.words[i] = ~words[i];
+		}
+		return m;
+	}
+
+	WideMask& operator&=(const WideMask& other) { for (int i = 0; i < WORDS; ++i) words[i] &= other.words[i]; return *this; }
+	WideMask& operator|=(const WideMask& other) { for (int i = 0; i < WORDS; ++i) words[i] |= other.words[i]; return *this; }
+	WideMask& operator^=(const WideMask& other) { for (int i = 0; i < WORDS; ++i) words[i] ^= other.words[i]; return *this; }
+
+	friend WideMask operator&(WideMask a, const WideMask& b) { return a &= b; }
+	friend WideMask operator|(WideMask a, const WideMask& b) { return a |= b; }
+	friend WideMask operator^(WideMask a, const WideMask& b) { return a ^= b; }
+
+	// bits shifted past the last word are lost, like with an integer
+	WideMask operator<<(int n) const
+	{
+		assert(n >= 0);
+		WideMask m;
+		int wordShift = n / 64;
+		int bitShift = n % 64;
+		for (int i = WORDS - 1; i >= wordShift; --i)
+		{
+			uint64_t word = words[i - wordShift] << bitShift;
+			if (bitShift != 0 && i - wordShift > 0)
+			{
+				word |= words[i - wordShift - 1] >> (64 - bitShift);
+			}
+			m.words[i] = word;
+		}
+		return m;
+	}
+	WideMask operator>>(int n) const
+	{
+		assert(n >= 0);
+		WideMask m;
+		int wordShift = n / 64;
+		int bitShift = n % 64;
+		for (int i = 0; i + wordShift < WORDS; ++i)
+		{
+			uint64_t word = words[i + wordShift] >> bitShift;
+			if (bitShift != 0 && i + wordShift + 1 < WORDS)
+			{
+				word |= words[i + wordShift + 1] << (64 - bitShift);
+			}
+			m.words[i] = word;
+		}
+		return m;
+	}
+
+	// e.g. m & (m - 1) clears the lowest bit
+	WideMask operator-(uint64_t value) const
+	{
+		WideMask m = *this;
+		for (int i = 0; i < WORDS && value != 0; ++i)
+		{
+			uint64_t word = m.words[i];
+			m.words[i] = word - value;
+			value = word < value ? 1 : 0;
+		}
+		return m;
+	}
+
+	friend bool operator==(const WideMask& a, const WideMask& b)
+	{
+		uint64_t diff = 0;
+		for (int i = 0; i < WORDS; ++i)
+		{
+			diff |= a.words[i] ^ b.words[i];
+		}
+		return diff == 0;
+	}
+	friend bool operator!=(const WideMask& a, const WideMask& b) { return !(a == b); }
+	// m != 0 would be ambiguous with the bool test otherwise
+	friend bool operator==(const WideMask& a, int b) { return a == WideMask(static_cast<uint64_t>(b)); }
+	friend bool operator!=(const WideMask& a, int b) { return !(a == b); }
+};
+
+// The mask type of NUM_BITS bits: a plain integer when they fit in one, the operations on it stay single instructions
+template <int NUM_BITS, bool WIDE = (NUM_BITS > 64)>
+struct MaskOf
+{
+	typedef uint64_t Type;
+	static Type bit(int idx) { assert(idx >= 0 && idx < NUM_BITS); return 1ULL << idx; }
+	// the mask of (NUM_BITS + 63) / 64 words, lowest first
+	static Type fromWords(const uint64_t* words) { return words[0]; }
+};
+
+template <int NUM_BITS>
+struct MaskOf<NUM_BITS, true>
+{
+	typedef WideMask<(NUM_BITS + 63) / 64> Type;
+	static Type bit(int idx) { assert(idx >= 0 && idx < NUM_BITS); return Type::bit(idx); }
+	static Type fromWords(const uint64_t* words)
+	{
+		Type m;
+		for (int i = 0; i < (NUM_BITS + 63) / 64; ++i)
+		{
+			m.words[i] = words[i];
+		}
+		return m;
+	}
+};
+
+namespace BitUtils
+{
+	template <int WORDS>
+	int countBits(const WideMask<WORDS>& m)
+	{
+		int count = 0;
+		for (int i = 0; i < WORDS; ++i)
+		{
+			count += countBits(m.words[i]);
+		}
+		return count;
+	}
+
+	// m must not be 0
+	template <int WORDS>
+	int lowestBit(const WideMask<WORDS>& m)
+	{
+		for (int i = 0; i < WORDS; ++i)
+		{
+			if (m.words[i])
+				return 64 * i + lowestBit(m.words[i]);
+		}
+		assert(false && "lowestBit of an empty mask");
+		return -1;
+	}
+
+	// m must not be 0
+	template <int WORDS>
+	int highestBit(const WideMask<WORDS>& m)
+	{
+		for (int i = WORDS - 1; i >= 0; --i)
+		{
+			if (m.words[i])
+				return 64 * i + highestBit(m.words[i]);
+		}
+		assert(false && "highestBit of an empty mask");
+		return -1;
+	}
+};
+
+#endif//WIDE_MASK_H